@@ -19,12 +19,14 @@ def parse_args():
     parser.add_argument("--program","-p",dest="program", type=str, help="name of workload")
     parser.add_argument("--task", "-t",dest="task", type=str, help="type of analysis routine")
     parser.add_argument("--config", type=str, default="IssueModelx1", help="Path to the config file")
+    parser.add_argument("--harness-socket", type=str, default=None, help="Submit runs to a harness job server (zsim --server <socket>)")
     # options for profiling
     parser.add_argument("--profiling-force", action="store_true", help="Force to do profiling")
     parser.add_argument("--profiling-order", type=int, default=0, help="Order of the profiling routine")
     parser.add_argument("--profiling-slice-size", type=int, default=100000000, help="Size of the slice during profiling")
     parser.add_argument("--profiling-emit-first", type=bool, default=True, help="Emit the first slice")
     parser.add_argument("--profiling-emit-last", type=bool, default=True, help="Emit the last slice")
+    parser.add_argument("--profiling-skip", type=int, default=0, help="Instructions to skip at native speed before profiling")
 
     config = vars(parser.parse_args())
 
@@ -63,14 +65,20 @@ class ZSimRunner:
         zsim_cfg['process0'] = {
             'command' : utils.get_app_option(self.config, 'command'),
         }
+        if self.config['profiling_skip'] > 0:
+            zsim_cfg['process0']['skipInstrs'] = self.config['profiling_skip']
         if utils.check_app_option(self.config, 'stdin'):
             zsim_cfg['process0']['input'] = utils.get_app_option(self.config, 'stdin')
         if utils.check_app_option(self.config, 'loader'):
             zsim_cfg['process0']['loader'] = utils.get_app_option(self.config, 'load')
         if utils.check_app_option(self.config, 'env'):
             zsim_cfg['process0']['env'] = utils.get_app_option(self.config, 'env')
+        # The global heap is reserved lazily, so the 16GB default fits most apps and lets the harness
+        # reuse its pooled segment; only override it for apps that need more
         if utils.check_app_option(self.config, 'heap'):
-            zsim_cfg['sim']['gmMBytes'] = int(utils.get_app_option(self.config, 'heap'))
+            heap_mbytes = int(utils.get_app_option(self.config, 'heap'))
+            if heap_mbytes > (1 << 14):  # sim.gmMBytes default
+                zsim_cfg['sim']['gmMBytes'] = heap_mbytes
 
         run_dir = tempfile.mkdtemp()
         with open(os.path.join(run_dir, 'zsim.cfg'), 'w') as f:
@@ -83,8 +91,12 @@ class ZSimRunner:
         os.symlink(utils.get_app_bin(self.config), os.path.join(run_dir, 'base.exe'))
 
         # run!
-        self.logger.info(f"Running {profling_cmd}")
-        utils.ex_log(profling_cmd, log_file=self.config['log_file'], cwd=run_dir)
+        if self.config['harness_socket']:
+            self.logger.info(f"Submitting {run_dir}/zsim.cfg to {self.config['harness_socket']}")
+            utils.submit_log(self.config['harness_socket'], os.path.join(run_dir, 'zsim.cfg'), log_file=self.config['log_file'], cwd=run_dir)
+        else:
+            self.logger.info(f"Running {profling_cmd}")
+            utils.ex_log(profling_cmd, log_file=self.config['log_file'], cwd=run_dir)
 
         # remove the run_dir
         shutil.rmtree(run_dir)
@@ -0,0 +1,153 @@
+import os
+import struct
+import fnmatch
+import numpy as np
+
+# Reader for zsim's delta-compressed periodic stats (sim.periodicStatsFormat = "delta").
+# See src/delta_stats.h for the file format.
+
+FILE_MAGIC  = b'ZDSTATS1'
+BLOCK_MAGIC = 0x4b42445a
+BLOCK_HDR   = struct.Struct('<IIQI')
+CONST, STRIDE, DELTAS = 0, 1, 2
+
+
+def decode_varints(buf):
+    # vectorized LEB128 decode of a whole payload
+    b      = np.frombuffer(buf, dtype=np.uint8)
+    ends   = np.flatnonzero(b < 0x80)
+    if len(ends) == 0:
+        return np.empty(0, dtype=np.uint64)
+    starts = np.empty_like(ends)
+    starts[0], starts[1:] = 0, ends[:-1] + 1
+    shift  = np.arange(len(b), dtype=np.uint64) - np.repeat(starts.astype(np.uint64), ends - starts + 1)
+    vals   = (b & 0x7f).astype(np.uint64) << (shift * np.uint64(7))
+    return np.bitwise_or.reduceat(vals, starts)
+
+
+def unzigzag(z):
+    return (z >> np.uint64(1)) ^ (np.uint64(0) - (z & np.uint64(1)))
+
+
+class DeltaReader:
+    def __init__(self, stats_file):
+        self.stats_file = stats_file
+        with open(stats_file, 'rb') as f:
+            data = f.read()
+        if data[:8] != FILE_MAGIC:
+            raise ValueError(f"{stats_file} is not a delta stats file")
+        ncols, names_bytes = struct.unpack_from('<II', data, 8)
+        pos = 16 + names_bytes
+        self.columns = data[16:pos].decode().split('\n')[:-1]
+        assert len(self.columns) == ncols
+
+        # block index: (first record, records, payload offset, payload bytes); a partially written last block is ignored
+        self.data   = data
+        self._all   = None
+        self.blocks = []
+        self.nrecords = 0
+        while pos + BLOCK_HDR.size <= len(data):
+            magic, nrec, first, nbytes = BLOCK_HDR.unpack_from(data, pos)
+            if magic != BLOCK_MAGIC or first != self.nrecords:
+                raise ValueError(f"corrupt block header at offset {pos}")
+            pos += BLOCK_HDR.size
+            if pos + nbytes > len(data):
+                break
+            self.blocks.append((first, nrec, pos, nbytes))
+            self.nrecords += nrec
+            pos += nbytes
+
+    def __len__(self):
+        return self.nrecords
+
+    def _decode_block(self, nrec, off, nbytes):
+        tok   = decode_varints(self.data[off:off + nbytes])
+        ncols = len(self.columns)
+        # walk the column headers to find each column's keyframe and mode; everything else is vectorized
+        toks  = tok.tolist()
+        pos   = np.empty(ncols, dtype=np.int64)
+        modes = np.empty(ncols, dtype=np.int64)
+        p = 0
+        for c in range(ncols):
+            pos[c], mode = p, toks[p + 1]
+            modes[c] = mode
+            p += 2 + (0 if mode == CONST else 1 if mode == STRIDE else nrec - 1)
+        assert p == len(toks) and np.all(modes <= DELTAS), "corrupt block"
+        base = tok[pos]
+        out  = np.empty((nrec, ncols), dtype=np.uint64)
+        out[:] = base
+        rows = np.arange(nrec, dtype=np.uint64)[:, None]
+        idx  = np.flatnonzero(modes == STRIDE)
+        out[:, idx] += unzigzag(tok[pos[idx] + 2]) * rows
+        idx  = np.flatnonzero(modes == DELTAS)
+        if nrec > 1 and len(idx):
+            deltas = unzigzag(tok[pos[idx][None, :] + 2 + np.arange(nrec - 1)[:, None]])
+            out[1:, idx] += np.cumsum(deltas, axis=0, dtype=np.uint64)
+        return out
+
+    def read(self, start=0, stop=None, incremental=False):
+        # records [start, stop) x columns; cumulative values as dumped, or per-record increments
+        stop  = self.nrecords if stop is None else min(stop, self.nrecords)
+        first = start - 1 if incremental and start > 0 else start
+        parts = []
+        for (bfirst, nrec, off, nbytes) in self.blocks:
+            if bfirst + nrec <= first or bfirst >= stop:
+                continue
+            blk = self._decode_block(nrec, off, nbytes)
+            parts.append(blk[max(first - bfirst, 0):stop - bfirst])
+        res = np.concatenate(parts) if parts else np.empty((0, len(self.columns)), dtype=np.uint64)
+        if incremental:
+            res = np.diff(res, axis=0, prepend=np.zeros((1, len(self.columns)), dtype=np.uint64))
+            if first != start:
+                res = res[1:]
+        return res
+
+    def all(self):
+        # all records, cumulative; decoded once and cached
+        if self._all is None:
+            self._all = self.read()
+        return self._all
+
+    def get(self, pattern, incremental=False):
+        # columns whose names match a glob, e.g. 'root/MeMo/*/icount'; returns (records, matches)
+        idx = [i for i, name in enumerate(self.columns) if fnmatch.fnmatchcase(name, pattern)]
+        data = self.all()[:, idx]
+        return np.diff(data, axis=0, prepend=np.zeros((1, len(idx)), dtype=np.uint64)) if incremental else data
+
+    def group(self, path):
+        return DeltaGroup(self, path)
+
+
+class DeltaGroup:
+    '''Mimics indexing an HDF5 periodic stats group, e.g. f['stats']['root']['l1d'][:]['hGETS'],
+    which is (records, children[, vector elements]) for regular aggregates and (records[, elements]) otherwise.'''
+    def __init__(self, reader, path):
+        self.reader = reader
+        self.path   = path.rstrip('/')
+
+    def __len__(self):
+        return len(self.reader)
+
+    def __getitem__(self, key):
+        if isinstance(key, slice):
+            return self
+        prefix = self.path + '/'
+        cols = {}
+        for i, name in enumerate(self.reader.columns):
+            if not name.startswith(prefix):
+                continue
+            parts = name[len(prefix):].split('/')
+            child = None
+            if parts[0].isdigit():
+                child, parts = int(parts[0]), parts[1:]
+            if not parts or parts[0] != key:
+                continue
+            cols[(child, tuple(int(x) for x in parts[1:] if x.isdigit()))] = i
+        if not cols:
+            raise KeyError(f"{key} not found under {self.path}")
+        keys     = sorted(cols, key=lambda k: (-1 if k[0] is None else k[0], k[1]))
+        children = sorted({k[0] for k in keys if k[0] is not None})
+        elems    = sorted({k[1] for k in keys})
+        res = self.reader.all()[:, [cols[k] for k in keys]]
+        shape = (len(self.reader),) + ((len(children),) if children else ()) + ((len(elems),) if elems != [()] else ())
+        return res.reshape(shape)
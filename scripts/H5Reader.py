@@ -1,22 +1,34 @@
 import h5py as h5
 import os
 import numpy as np
+from scripts.DeltaReader import DeltaReader
 
 
 class H5Reader:
     def __init__(self, profiling_dir):
         self.core       = 'MeMo'
         self.stats_file = os.path.join(profiling_dir, 'zsim.h5')
+        self.delta      = None
         if not os.path.exists(self.stats_file):
-            raise ValueError(f"No file of {self.stats_file}")
+            # runs with sim.periodicStatsFormat = "delta"
+            delta_file = os.path.join(profiling_dir, 'zsim.dstats')
+            if not os.path.exists(delta_file):
+                raise ValueError(f"No file of {self.stats_file}")
+            self.stats_file = delta_file
+            self.delta      = DeltaReader(delta_file)
         self.core_stats = self.get_core_stats()
 
-    def get_core_stats(self):
+    def get_root_stat(self, name):
+        if self.delta is not None:
+            return self.delta.group('root/' + name)
         f = h5.File(self.stats_file, 'r')
-        core_stats = f['stats']['root'][self.core]
+        stat = f['stats']['root'][name]
         f.close()
 
-        return core_stats
+        return stat
+
+    def get_core_stats(self):
+        return self.get_root_stat(self.core)
 
     def get_stats(self, name):
         raw_data    = self.core_stats[:][name].reshape(-1)
@@ -32,9 +44,7 @@ class H5Reader:
         return incre_data
     
     def get_cache_miss_rate(self, name):
-        f = h5.File(self.stats_file, 'r')
-        cache_stats = f['stats']['root'][name]
-        f.close()
+        cache_stats = self.get_root_stat(name)
 
         if 'l1' in name:
             hits = np.sum(
@@ -58,9 +68,7 @@ class H5Reader:
         return miss_rate
 
     def get_cache_subsystem_avg_lat(self):
-        f = h5.File(self.stats_file, 'r')
-        cache_stats = f['stats']['root']['l1d']
-        f.close()
+        cache_stats = self.get_root_stat('l1d')
 
         hits = np.sum(
             cache_stats['fhGETS'] + cache_stats['fhGETX'] + cache_stats['hGETS'] + cache_stats['hGETX'],
@@ -81,6 +89,20 @@ class H5Reader:
 
         return avg_lat
     
+    def reuse_hist(self):
+        # per-slice log2 reuse distance histograms (ReuseModel); last bin is cold misses
+        hist = self.core_stats[:]['reuseDist'].reshape(len(self.core_stats), -1)
+        return np.diff(hist, axis=0, prepend=0)
+
+    def reuse_mrc(self):
+        # per-slice miss ratio of a fully-associative LRU cache of 2^k lines, for k in [0, bins-2]
+        hist = self.reuse_hist().astype(float)
+        total = np.sum(hist, axis=-1, keepdims=True)
+        total[total == 0] = 1
+        # accesses with distance >= 2^k fall in bins k+1 and above (including cold misses)
+        misses = np.cumsum(hist[:, ::-1], axis=-1)[:, ::-1][:, 1:]
+        return misses / total
+
     def br_misses(self):
         return self.get_stats('mispredBranches')
 
@@ -117,6 +117,28 @@ def ex_log(cmd, log_file, cwd=".", env=None):
     with open(log_file, "a") as f:
         f.write("[end time] %s\n" % time.strftime("%Y-%m-%d %H:%M:%S"))
 
+def submit_log(socket_path, cfg_file, log_file, cwd="."):
+    """Run a zsim job through a harness job server (zsim --server) instead of a new harness."""
+    import socket
+    import time
+    with open(log_file, "a") as f:
+        f.write("[cwd] %s\n" % cwd)
+        f.write("[submit] %s %s\n" % (socket_path, cfg_file))
+        f.write("[begin time] %s\n" % time.strftime("%Y-%m-%d %H:%M:%S"))
+    status = None
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as s:
+        s.connect(socket_path)
+        s.sendall(f"{os.path.abspath(cfg_file)} {os.path.abspath(cwd)}\n".encode())
+        for line in s.makefile():
+            with open(log_file, "a") as f:
+                f.write("[server] %s" % line)
+            status = line.split()
+    with open(log_file, "a") as f:
+        f.write("[end time] %s\n" % time.strftime("%Y-%m-%d %H:%M:%S"))
+    # Last line is "DONE <jobId> <exitCode> <runDir>" or "ERROR <reason>"
+    if not status or status[0] != "DONE" or status[2] != "0":
+        raise RuntimeError("zsim job %s failed: %s" % (cfg_file, " ".join(status or ["no reply"])))
+
 def get_fullname(raw):
     name_mapper = {
         "STREAM": "STREAM",
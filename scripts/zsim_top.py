@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+"""Aggregate the live telemetry records of all zsim processes on this node.
+
+Each zsim process publishes a fixed-layout record in <sim.telemetryDir>/<pid>.tel
+(see src/telemetry.h). This reads them all and prints one line per process,
+flagging runs whose record has not been updated recently (STALE) and records
+left behind by processes that died (DEAD).
+
+Liveness is per process: a record is refreshed at each of that process's slice
+ends and every TELEMETRY_PHASE_INTERVAL phases that its own threads run. A
+process whose threads are all blocked in syscalls or fast-forwarding stops
+refreshing and shows as STALE even while other processes of the run advance.
+"""
+import argparse
+import glob
+import os
+import struct
+import time
+
+TELEMETRY_MAGIC = 0x454c45544d49535a
+TELEMETRY_VERSION = 1
+# Must match struct TelemetryRecord
+RECORD_FMT = '<QIIQQQQQQQQQQQQQ256s'
+RECORD_FIELDS = ['magic', 'version', 'procIdx', 'pid', 'startNs', 'updateNs',
+                 'instrs', 'slices', 'phases', 'hostKips',
+                 'boundNs', 'weaveNs', 'ffNs', 'statsDumpNs',
+                 'heapUsedBytes', 'heapBytes', 'outputDir']
+RECORD_SIZE = struct.calcsize(RECORD_FMT)
+
+
+def read_record(path):
+    try:
+        with open(path, 'rb') as f:
+            data = f.read(RECORD_SIZE)
+    except OSError:
+        return None  # raced with a clean exit
+    if len(data) < RECORD_SIZE:
+        return None
+    rec = dict(zip(RECORD_FIELDS, struct.unpack(RECORD_FMT, data)))
+    if rec['magic'] != TELEMETRY_MAGIC or rec['version'] != TELEMETRY_VERSION:
+        return None  # still initializing, or from another zsim version
+    rec['outputDir'] = rec['outputDir'].split(b'\0', 1)[0].decode(errors='replace')
+    rec['path'] = path
+    return rec
+
+
+def pid_alive(pid):
+    try:
+        os.kill(pid, 0)
+    except ProcessLookupError:
+        return False
+    except PermissionError:
+        pass
+    return True
+
+
+def read_records(telemetry_dir):
+    recs = [read_record(p) for p in glob.glob(os.path.join(telemetry_dir, '*.tel'))]
+    return [r for r in recs if r is not None]
+
+
+def fmt_pct(part, total):
+    return '%5.1f' % (100.0 * part / total) if total else '    -'
+
+
+def print_table(recs, stale_secs):
+    now_ns = time.time_ns()
+    print('%8s %4s %14s %6s %8s %6s %6s %6s %6s %9s %7s %-6s %s' % (
+        'PID', 'PROC', 'INSTRS', 'SLICES', 'MIPS', 'BOUND%', 'WEAVE%', 'FF%', 'DUMP%',
+        'HEAP(MB)', 'AGE(s)', 'STATE', 'OUTPUT'))
+    total_mips = 0.0
+    for r in sorted(recs, key=lambda r: r['updateNs']):
+        age = (now_ns - r['updateNs']) / 1e9
+        if not pid_alive(r['pid']):
+            state = 'DEAD'
+        elif age > stale_secs:
+            state = 'STALE'
+        else:
+            state = 'OK'
+            total_mips += r['hostKips'] / 1000.0
+        sim_ns = r['boundNs'] + r['weaveNs'] + r['ffNs']
+        print('%8d %4d %14d %6d %8.2f %6s %6s %6s %6s %9d %7.0f %-6s %s' % (
+            r['pid'], r['procIdx'], r['instrs'], r['slices'], r['hostKips'] / 1000.0,
+            fmt_pct(r['boundNs'], sim_ns), fmt_pct(r['weaveNs'], sim_ns), fmt_pct(r['ffNs'], sim_ns),
+            fmt_pct(r['statsDumpNs'], now_ns - r['startNs']),
+            r['heapUsedBytes'] >> 20, age, state, r['outputDir']))
+    print('%d processes, %.1f aggregate MIPS (live processes)' % (len(recs), total_mips))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Show live telemetry of all zsim processes on this node')
+    parser.add_argument('--dir', type=str, default='/dev/shm/zsim-telemetry', help='sim.telemetryDir of the runs')
+    parser.add_argument('--interval', type=float, default=0, help='refresh every this many seconds (0: print once)')
+    parser.add_argument('--stale', type=float, default=600, help='flag runs not updated in this many seconds')
+    parser.add_argument('--prune', action='store_true', help='remove records left by dead processes')
+    args = parser.parse_args()
+
+    while True:
+        recs = read_records(args.dir)
+        if args.prune:
+            for r in [r for r in recs if not pid_alive(r['pid'])]:
+                os.unlink(r['path'])
+                recs.remove(r)
+        if args.interval:
+            print('\033[2J\033[H', end='')
+        print_table(recs, args.stale)
+        if not args.interval:
+            break
+        time.sleep(args.interval)
+
+
+if __name__ == '__main__':
+    main()
@@ -47,28 +47,13 @@
 #define L1I_LAT 3  
 #define L1D_LAT 4  
 
-/* global */
-extern int64_t  interval_size;
-extern uint64_t interval_pcount;
-extern uint64_t interval_icount;
-extern uint64_t total_pcount;
-extern uint64_t total_icount;
-
-CacheModel::CacheModel(FilterCache* _l1d, const OOOParams& ooo_params, g_string& _name) : Core(_name), l1d(_l1d), ooo_width(ooo_params.width), ooo_prf_ports(ooo_params.prf_ports), cRec(0, _name) {
-    decodeCycle = DECODE_STAGE;  // allow subtracting from it
-    curCycle = 0;
-    phaseEndCycle = zinfo->phaseLength;
-
-    for (uint32_t i = 0; i < MAX_REGISTERS; i++) {
+CacheModel::CacheModel(FilterCache* _l1d, const OOOParams& ooo_params, g_string& _name) : MeMoTimingCore(_name, DECODE_STAGE /*allow subtracting from it*/), l1d(_l1d), ooo_width(ooo_params.width), ooo_prf_ports(ooo_params.prf_ports) {
+    for (uint32_t i = 0; i < MAX_UOP_REGS; i++) {
         regScoreboard[i] = 0;
     }
-    prevBbl = nullptr;
-
     lastStoreCommitCycle = 0;
     lastStoreAddrCommitCycle = 0;
 
-    instrs = 0;
-
     // assert(ooo_params.rob_cap     >= ooo_params.ins_win_cap);
     // assert(ooo_params.ins_win_cap >= ooo_params.issue_queue_cap);
     // assert(ooo_params.ins_win_cap >= ooo_params.load_queue_cap);
@@ -80,30 +65,12 @@ void CacheModel::initStats(AggregateStat* parentStat) {
     AggregateStat* coreStat = new AggregateStat();
     coreStat->init(name.c_str(), "Core stats");
 
-    auto x = [this]() { return cRec.getUnhaltedCycles(curCycle); };
-    LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
-    cyclesStat->init("cycles", "Simulated unhalted cycles");
-
-    auto y = [this]() { return cRec.getContentionCycles(); };
-    LambdaStat<decltype(y)>* cCyclesStat = new LambdaStat<decltype(y)>(y);
-    cCyclesStat->init("cCycles", "Cycles due to contention stalls");
 
-    ProxyStat* pcountStat = new ProxyStat();
-    pcountStat->init("pcount", "Simulated instructions", &total_pcount);
-    ProxyStat* icountStat = new ProxyStat();
-    icountStat->init("icount", "Simulated instructions", &total_icount);
-
-    coreStat->append(cyclesStat);
-    coreStat->append(cCyclesStat);
-    coreStat->append(icountStat);
-    coreStat->append(pcountStat);
+    initTimingStats(coreStat);
 
     parentStat->append(coreStat);
 }
 
-uint64_t CacheModel::getInstrs() const {return instrs;}
-uint64_t CacheModel::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
-
 void CacheModel::contextSwitch(int32_t gid) {
     if (gid == -1) {
         // Do not execute previous BBL, as we were context-switched
@@ -115,7 +82,7 @@ void CacheModel::contextSwitch(int32_t gid) {
 }
 
 
-InstrFuncPtrs CacheModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc, BranchFunc, PredLoadFunc, PredStoreFunc, FPTR_ANALYSIS, {0}};}
+InstrFuncPtrs CacheModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc<CacheModel>, BranchFunc, PredLoadFunc, PredStoreFunc, MemBufFunc, FPTR_ANALYSIS};}
 
 inline void CacheModel::load(Address addr) {
     loadAddrs[loads++] = addr;
@@ -152,17 +119,25 @@ inline void CacheModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
     uint32_t loadIdx = 0;
     uint32_t storeIdx = 0;
 
-    uint32_t prevDecCycle = 0;
+    /* All of this BBL's addresses are known upfront, so prefetch their filter
+     * entries before simulating them in order. This overlaps the simulator's own
+     * host cache misses on the filter when the simulated footprint is large.
+     */
+    for (uint32_t i = 0; i < loads; i++) {
+        if (loadAddrs[i] != ((Address)-1L)) l1d->prefetchFilter(loadAddrs[i]);
+    }
+    for (uint32_t i = 0; i < stores; i++) {
+        if (storeAddrs[i] != ((Address)-1L)) l1d->prefetchFilter(storeAddrs[i]);
+    }
 
     // Run dispatch/IW
     for (uint32_t i = 0; i < bbl->uops; i++) {
         DynUop* uop = &(bbl->uop[i]);
 
         // Decode stalls
-        uint32_t decDiff = uop->decCycle - prevDecCycle;
+        uint32_t decDiff = uop->decDiff;
         decodeCycle = decodeCycle + decDiff;
         curCycle = MAX(curCycle, decodeCycle);
-        prevDecCycle = uop->decCycle;
 
         // Kill dependences on invalid register
         // Using curCycle saves us two unpredictable branches in the RF read stalls code
@@ -285,49 +260,7 @@ inline void CacheModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
         decodeCycle = minFetchDecCycle;
     }
 
-    if(interval_icount >= (uint64_t)interval_size) {
-        cerr << "interval_icount: " << interval_icount << " total_icount: " << total_icount <<endl;
-        zinfo -> periodicStatsBackend -> dump(false);// flushes trace writer
-        interval_icount = 0;
-        interval_pcount = 0;
-    }
-}
-
-// Timing simulation code
-void CacheModel::join() {
-    DEBUG_MSG("[%s] Joining, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-    uint64_t targetCycle = cRec.notifyJoin(curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-    phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
-    // assert(targetCycle <= phaseEndCycle);
-    DEBUG_MSG("[%s] Joined, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-}
-
-void CacheModel::leave() {
-    DEBUG_MSG("[%s] Leaving, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-    cRec.notifyLeave(curCycle);
-}
-
-void CacheModel::cSimStart() {
-    uint64_t targetCycle = cRec.cSimStart(curCycle);
-    assert(targetCycle >= curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-}
-
-void CacheModel::cSimEnd() {
-    uint64_t targetCycle = cRec.cSimEnd(curCycle);
-    assert(targetCycle >= curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-}
-
-void CacheModel::advance(uint64_t targetCycle) {
-    assert(targetCycle > curCycle);
-    decodeCycle += targetCycle - curCycle;
-    curCycle = targetCycle;
-    /* NOTE: Validation with weave mems shows that not advancing internal cycle
-     * counters in e.g., the ROB does not change much; consider full-blown
-     * rebases though if weave models fail to validate for some app.
-     */
+    endOfBbl();
 }
 
 // Pin interface code
@@ -347,23 +280,13 @@ void CacheModel::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {
     else core->predFalseStore();
 }
 
-void CacheModel::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+void CacheModel::MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n) {
     CacheModel* core = static_cast<CacheModel*>(cores[tid]);
-    core->bbl(bblAddr, bblInfo, tid);
-
-    while (core->curCycle > core->phaseEndCycle) {
-        core->phaseEndCycle += zinfo->phaseLength;
-
-        uint32_t cid = getCid(tid);
-        // NOTE: TakeBarrier may take ownership of the core, and so it will be used by some other thread. If TakeBarrier context-switches us,
-        // the *only* safe option is to return inmmediately after we detect this, or we can race and corrupt core state. However, the information
-        // here is insufficient to do that, so we could wind up double-counting phases.
-        uint32_t newCid = TakeBarrier(tid, cid);
-        // NOTE: Upon further observation, we cannot race if newCid == cid, so this code should be enough.
-        // It may happen that we had an intervening context-switch and we are now back to the same core.
-        // This is fine, since the loop looks at core values directly and there are no locals involved,
-        // so we should just advance as needed and move on.
-        if (newCid != cid) break;  /*context-switch, we do not own this context anymore*/
+    for (uint32_t i = 0; i < n; i++) {
+        Address addr = addrs[i] & ~MEMBUF_STORE;
+        if (addr == MEMBUF_PRED_FALSE) addr = -1L;
+        if (addrs[i] & MEMBUF_STORE) core->store(addr);
+        else core->load(addr);
     }
 }
 
@@ -26,20 +26,17 @@
 #ifndef CACHE_CORE_H
 #define CACHE_CORE_H
 
+#include "MeMoCore.h"
 #include "legos.h"
 
-class CacheModel : public Core {
+class CacheModel : public MeMoTimingCore {
     private:
         FilterCache* l1d;
         const uint32_t ooo_width;
         const uint32_t ooo_prf_ports;
 
-        uint64_t phaseEndCycle; //next stopping point
-
-        uint64_t curCycle; //this model is issue-centric; curCycle refers to the current issue cycle
-        uint64_t regScoreboard[MAX_REGISTERS]; //contains timestamp of next issue cycles where each reg can be sourced
-
-        BblInfo* prevBbl;
+        // curCycle is issue-centric; it refers to the current issue cycle
+        uint64_t regScoreboard[MAX_UOP_REGS]; //contains timestamp of next issue cycles where each reg can be sourced
 
         //Record load and store addresses
         Address loadAddrs[256];
@@ -50,10 +47,6 @@ class CacheModel : public Core {
         uint64_t lastStoreCommitCycle;
         uint64_t lastStoreAddrCommitCycle; //tracks last store addr uop, all loads queue behind it
 
-        uint64_t decodeCycle;
-
-        uint64_t instrs;
-
         // Load-store forwarding
         // Just a direct-mapped array of last store cycles to 4B-wide blocks
         // (i.e., indexed by (addr >> 2) & (FWD_ENTRIES-1))
@@ -63,43 +56,22 @@ class CacheModel : public Core {
             void set(Address a, uint64_t c) {addr = a; storeCycle = c;}
         };
 
-        OOOCoreRecorder cRec;
-
     public:
         CacheModel(FilterCache* _l1d, const OOOParams& oo_params, g_string& _name);
 
         void initStats(AggregateStat* parentStat);
 
-        uint64_t getInstrs() const;
-        uint64_t getPhaseCycles() const;
-        uint64_t getCycles() const {return cRec.getUnhaltedCycles(curCycle);}
-
         void contextSwitch(int32_t gid);
 
-        virtual void join();
-        virtual void leave();
-
         InstrFuncPtrs GetFuncPtrs();
-
-        // Contention simulation interface
-        inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
-        void cSimStart();
-        void cSimEnd();
+        uint32_t GetInstrReqs() const {return INSTR_REQ_MEM;}
 
     private:
+        friend class MeMoCore;  // calls bbl()
+
         inline void load(Address addr);
         inline void store(Address addr);
 
-        /* NOTE: Analysis routines cannot touch curCycle directly, must use
-         * advance() for long jumps or insWindow.advancePos() for 1-cycle
-         * jumps.
-         *
-         * UPDATE: With decodeCycle, this difference is more serious. ONLY
-         * cSimStart and cSimEnd should call advance(). advance() is now meant
-         * to advance the cycle counters in the whole core in lockstep.
-         */
-        inline void advance(uint64_t targetCycle);
-
         // Predicated loads and stores call this function, gets recorded as a 0-cycle op.
         // Predication is rare enough that we don't need to model it perfectly to be accurate (i.e. the uops still execute, retire, etc), but this is needed for correctness.
         inline void predFalseLoad();
@@ -111,7 +83,7 @@ class CacheModel : public Core {
         static void StoreFunc(THREADID tid, ADDRINT addr);
         static void PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred);
         static void PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred);
-        static void BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo);
+        static void MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n);
         static void BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc);
 } ATTR_LINE_ALIGNED;  // Take up an int number of cache lines
 
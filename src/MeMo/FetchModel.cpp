@@ -46,26 +46,13 @@
 
 #define L1D_LAT 4  // fixed, and FilterCache does not include L1 delay
 
-/* global */
-extern int64_t  interval_size;
-extern uint64_t interval_pcount;
-extern uint64_t interval_icount;
-extern uint64_t total_pcount;
-extern uint64_t total_icount;
-
-FetchModel::FetchModel(FilterCache* _l1i, const OOOParams& ooo_params, g_string& _name) : Core(_name), l1i(_l1i), ooo_width(ooo_params.width), fetch_bytes_per_cycle(ooo_params.fetch_bytes_per_cycle), cRec(0, _name) {
-    decodeCycle = DECODE_STAGE;  // allow subtracting from it
-    curCycle = 0;
-    phaseEndCycle = zinfo->phaseLength;
-
-    for (uint32_t i = 0; i < MAX_REGISTERS; i++) {
+FetchModel::FetchModel(FilterCache* _l1i, const OOOParams& ooo_params, g_string& _name) : MeMoTimingCore(_name, DECODE_STAGE /*allow subtracting from it*/), l1i(_l1i), ooo_width(ooo_params.width), fetch_bytes_per_cycle(ooo_params.fetch_bytes_per_cycle) {
+    for (uint32_t i = 0; i < MAX_UOP_REGS; i++) {
         regScoreboard[i] = 0;
     }
-    prevBbl = nullptr;
-
     branchPc = 0;
 
-    instrs = mispredBranches = 0;
+    mispredBranches = 0;
 
     // initialize branch predictor
     branchPred = gm_memalign<BranchPredictorTage>(CACHE_LINE_BYTES);
@@ -76,36 +63,18 @@ void FetchModel::initStats(AggregateStat* parentStat) {
     AggregateStat* coreStat = new AggregateStat();
     coreStat->init(name.c_str(), "Core stats");
 
-    auto x = [this]() { return cRec.getUnhaltedCycles(curCycle); };
-    LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
-    cyclesStat->init("cycles", "Simulated unhalted cycles");
-
-    auto y = [this]() { return cRec.getContentionCycles(); };
-    LambdaStat<decltype(y)>* cCyclesStat = new LambdaStat<decltype(y)>(y);
-    cCyclesStat->init("cCycles", "Cycles due to contention stalls");
-
-    ProxyStat* pcountStat = new ProxyStat();
-    pcountStat->init("pcount", "Simulated instructions", &total_pcount);
-    ProxyStat* icountStat = new ProxyStat();
-    icountStat->init("icount", "Simulated instructions", &total_icount);
     ProxyStat* mispredBranchesStat = new ProxyStat();
     mispredBranchesStat->init("mispredBranches", "Mispredicted branches", &mispredBranches);
     profFetchStalls = new Counter();
     profFetchStalls->init("fetchStalls",  "Fetch stalls");  
 
-    coreStat->append(cyclesStat);
-    coreStat->append(cCyclesStat);
-    coreStat->append(icountStat);
-    coreStat->append(pcountStat);
+    initTimingStats(coreStat);
     coreStat->append(mispredBranchesStat);
     coreStat->append(profFetchStalls);
 
     parentStat->append(coreStat);
 }
 
-uint64_t FetchModel::getInstrs() const {return instrs;}
-uint64_t FetchModel::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
-
 void FetchModel::contextSwitch(int32_t gid) {
     if (gid == -1) {
         // Do not execute previous BBL, as we were context-switched
@@ -117,7 +86,7 @@ void FetchModel::contextSwitch(int32_t gid) {
 }
 
 
-InstrFuncPtrs FetchModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc, BranchFunc, PredLoadFunc, PredStoreFunc, FPTR_ANALYSIS, {0}};}
+InstrFuncPtrs FetchModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc<FetchModel>, BranchFunc, PredLoadFunc, PredStoreFunc, MemBufFunc, FPTR_ANALYSIS};}
 
 void FetchModel::branch(Address pc, bool taken, Address takenNpc, Address notTakenNpc) {
     branchPc = pc;
@@ -133,12 +102,17 @@ inline void FetchModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
         return;
     }
 
+    // Unless it needed an explicit callback, the previous BBL's conditional branch
+    // went wherever execution continued. A successor that is neither target means
+    // we returned from uninstrumented code, so the outcome is unknown and we skip it
+    if (!branchPc && prevBbl->brPc && (bblAddr == prevBbl->brTakenNpc || bblAddr == prevBbl->brNotTakenNpc)) {
+        branch(prevBbl->brPc, bblAddr == prevBbl->brTakenNpc, prevBbl->brTakenNpc, prevBbl->brNotTakenNpc);
+    }
+
     /* Simulate execution of previous BBL */
     uint32_t bblInstrs = prevBbl->instrs;
     DynBbl* bbl = &(prevBbl->oooBbl[0]);
     prevBbl = bblInfo;
-
-    uint32_t prevDecCycle = 0;
     uint64_t lastCommitCycle = 0;  // used to find misprediction penalty
 
     // Run dispatch/IW
@@ -146,10 +120,9 @@ inline void FetchModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
         DynUop* uop = &(bbl->uop[i]);
 
         // Decode stalls
-        uint32_t decDiff = uop->decCycle - prevDecCycle;
+        uint32_t decDiff = uop->decDiff;
         decodeCycle = decodeCycle + decDiff;
         curCycle = MAX(curCycle, decodeCycle);
-        prevDecCycle = uop->decCycle;
 
         // Kill dependences on invalid register
         // Using curCycle saves us two unpredictable branches in the RF read stalls code
@@ -242,15 +215,28 @@ inline void FetchModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
     branchPc = 0;  // clear for next BBL
 
     // Simulate current bbl ifetch
+    // The Nehalem frontend fetches instructions in 16-byte-wide accesses.
+    // Do not model fetch throughput limit here, decoder-generated stalls already include it
+    // We always call fetches with curCycle to avoid upsetting the weave
+    // models (but we could move to a fetch-centric recorder to avoid this)
+    /* Fetches to the same line are back-to-back and take the same latency
+     * (all but the first hit in the filter cache and record no events), so we
+     * probe each distinct line once and charge it once per fetch it covers.
+     */
+    uint32_t fetchStep = min(lineSize, fetch_bytes_per_cycle);
     Address endAddr = bblAddr + bblInfo->bytes;
-    for (Address fetchAddr = bblAddr; fetchAddr < endAddr; fetchAddr += min(lineSize, fetch_bytes_per_cycle)) {
-        // The Nehalem frontend fetches instructions in 16-byte-wide accesses.
-        // Do not model fetch throughput limit here, decoder-generated stalls already include it
-        // We always call fetches with curCycle to avoid upsetting the weave
-        // models (but we could move to a fetch-centric recorder to avoid this)
-        uint64_t fetchLat = l1i->load(fetchAddr, curCycle) - curCycle;
+    Address lineAddr = bblAddr >> lineBits;
+    Address endLineAddr = (endAddr - 1) >> lineBits;
+    uint32_t prevFetches = 0;  // fetches issued before the current line, i.e., ceil((lineStart - bblAddr)/fetchStep)
+    for (; lineAddr <= endLineAddr; lineAddr++) {
+        Address lineEnd = MIN((lineAddr + 1) << lineBits, endAddr);
+        uint32_t fetches = (lineEnd - bblAddr + fetchStep - 1)/fetchStep;  // fetches issued before lineEnd
+        uint32_t lineFetches = fetches - prevFetches;
+        prevFetches = fetches;
+        if (!lineFetches) continue;  // with fetchStep == lineSize, unaligned fetches can skip the tail line
+        uint64_t fetchLat = l1i->loadRepeated(bblAddr + (fetches - lineFetches)*fetchStep, curCycle, lineFetches) - curCycle;
         cRec.record(curCycle, curCycle, curCycle + fetchLat);
-        fetchCycle += fetchLat;
+        fetchCycle += lineFetches*fetchLat;
     }
 
     // If fetch rules, take into account delay between fetch and decode;
@@ -262,49 +248,7 @@ inline void FetchModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
         decodeCycle = minFetchDecCycle;
     }
 
-    if(interval_icount >= (uint64_t)interval_size) {
-        cerr << "interval_icount: " << interval_icount << " total_icount: " << total_icount <<endl;
-        zinfo -> periodicStatsBackend -> dump(false);// flushes trace writer
-        interval_icount = 0;
-        interval_pcount = 0;
-    }
-}
-
-// Timing simulation code
-void FetchModel::join() {
-    DEBUG_MSG("[%s] Joining, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-    uint64_t targetCycle = cRec.notifyJoin(curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-    phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
-    // assert(targetCycle <= phaseEndCycle);
-    DEBUG_MSG("[%s] Joined, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-}
-
-void FetchModel::leave() {
-    DEBUG_MSG("[%s] Leaving, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-    cRec.notifyLeave(curCycle);
-}
-
-void FetchModel::cSimStart() {
-    uint64_t targetCycle = cRec.cSimStart(curCycle);
-    assert(targetCycle >= curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-}
-
-void FetchModel::cSimEnd() {
-    uint64_t targetCycle = cRec.cSimEnd(curCycle);
-    assert(targetCycle >= curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-}
-
-void FetchModel::advance(uint64_t targetCycle) {
-    assert(targetCycle > curCycle);
-    decodeCycle += targetCycle - curCycle;
-    curCycle = targetCycle;
-    /* NOTE: Validation with weave mems shows that not advancing internal cycle
-     * counters in e.g., the ROB does not change much; consider full-blown
-     * rebases though if weave models fail to validate for some app.
-     */
+    endOfBbl();
 }
 
 // Pin interface code
@@ -313,26 +257,7 @@ void FetchModel::LoadFunc(THREADID tid, ADDRINT addr) {}
 void FetchModel::StoreFunc(THREADID tid, ADDRINT addr) {}
 void FetchModel::PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred) {}
 void FetchModel::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {}
-
-void FetchModel::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
-    FetchModel* core = static_cast<FetchModel*>(cores[tid]);
-    core->bbl(bblAddr, bblInfo, tid);
-
-    while (core->curCycle > core->phaseEndCycle) {
-        core->phaseEndCycle += zinfo->phaseLength;
-
-        uint32_t cid = getCid(tid);
-        // NOTE: TakeBarrier may take ownership of the core, and so it will be used by some other thread. If TakeBarrier context-switches us,
-        // the *only* safe option is to return inmmediately after we detect this, or we can race and corrupt core state. However, the information
-        // here is insufficient to do that, so we could wind up double-counting phases.
-        uint32_t newCid = TakeBarrier(tid, cid);
-        // NOTE: Upon further observation, we cannot race if newCid == cid, so this code should be enough.
-        // It may happen that we had an intervening context-switch and we are now back to the same core.
-        // This is fine, since the loop looks at core values directly and there are no locals involved,
-        // so we should just advance as needed and move on.
-        if (newCid != cid) break;  /*context-switch, we do not own this context anymore*/
-    }
-}
+void FetchModel::MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n) {}
 
 void FetchModel::BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
     static_cast<FetchModel*>(cores[tid])->branch(pc, taken, takenNpc, notTakenNpc);
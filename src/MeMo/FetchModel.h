@@ -26,21 +26,17 @@
 #ifndef FETCH_CORE_H
 #define FETCH_CORE_H
 
+#include "MeMoCore.h"
 #include "legos.h"
 
-class FetchModel : public Core {
+class FetchModel : public MeMoTimingCore {
     private:
         FilterCache* l1i;
         const uint32_t ooo_width;
         const uint32_t fetch_bytes_per_cycle;
 
-        uint64_t phaseEndCycle; //next stopping point
-
-        uint64_t curCycle; //this model is issue-centric; curCycle refers to the current issue cycle
-        uint64_t regScoreboard[MAX_REGISTERS]; //contains timestamp of next issue cycles where each reg can be sourced
-
-        BblInfo* prevBbl;
-
+        // curCycle is issue-centric; it refers to the current issue cycle
+        uint64_t regScoreboard[MAX_UOP_REGS]; //contains timestamp of next issue cycles where each reg can be sourced
 
         Counter* profFetchStalls;
 
@@ -52,43 +48,20 @@ class FetchModel : public Core {
         Address branchTakenNpc;
         Address branchNotTakenNpc;
 
-        uint64_t decodeCycle;
-
-        uint64_t instrs, mispredBranches;
-
-        OOOCoreRecorder cRec;
+        uint64_t mispredBranches;
 
     public:
         FetchModel(FilterCache* _l1i, const OOOParams& oo_params, g_string& _name);
 
         void initStats(AggregateStat* parentStat);
 
-        uint64_t getInstrs() const;
-        uint64_t getPhaseCycles() const;
-        uint64_t getCycles() const {return cRec.getUnhaltedCycles(curCycle);}
-
         void contextSwitch(int32_t gid);
 
-        virtual void join();
-        virtual void leave();
-
         InstrFuncPtrs GetFuncPtrs();
-
-        // Contention simulation interface
-        inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
-        void cSimStart();
-        void cSimEnd();
+        uint32_t GetInstrReqs() const {return INSTR_REQ_BRANCH;}
 
     private:
-        /* NOTE: Analysis routines cannot touch curCycle directly, must use
-         * advance() for long jumps or insWindow.advancePos() for 1-cycle
-         * jumps.
-         *
-         * UPDATE: With decodeCycle, this difference is more serious. ONLY
-         * cSimStart and cSimEnd should call advance(). advance() is now meant
-         * to advance the cycle counters in the whole core in lockstep.
-         */
-        inline void advance(uint64_t targetCycle);
+        friend class MeMoCore;  // calls bbl()
 
         inline void branch(Address pc, bool taken, Address takenNpc, Address notTakenNpc);
 
@@ -98,7 +71,7 @@ class FetchModel : public Core {
         static void StoreFunc(THREADID tid, ADDRINT addr);
         static void PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred);
         static void PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred);
-        static void BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo);
+        static void MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n);
         static void BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc);
 } ATTR_LINE_ALIGNED;  // Take up an int number of cache lines
 
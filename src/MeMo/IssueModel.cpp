@@ -42,27 +42,13 @@
 
 #define L1D_LAT 4  // fixed, and FilterCache does not include L1 delay
 
-/* global */
-extern int64_t  interval_size;
-extern uint64_t interval_pcount;
-extern uint64_t interval_icount;
-extern uint64_t total_pcount;
-extern uint64_t total_icount;
-
-IssueModel::IssueModel(const OOOParams& ooo_params, g_string& _name) : Core(_name), ooo_width(ooo_params.width), ooo_prf_ports(ooo_params.prf_ports), cRec(0, _name) {
-    decodeCycle = DECODE_STAGE;  // allow subtracting from it
-    curCycle = 0;
-    phaseEndCycle = zinfo->phaseLength;
-
-    for (uint32_t i = 0; i < MAX_REGISTERS; i++) {
+IssueModel::IssueModel(const OOOParams& ooo_params, g_string& _name) : MeMoTimingCore(_name, DECODE_STAGE /*allow subtracting from it*/), ooo_width(ooo_params.width), ooo_prf_ports(ooo_params.prf_ports) {
+    for (uint32_t i = 0; i < MAX_UOP_REGS; i++) {
         regScoreboard[i] = 0;
     }
-    prevBbl = nullptr;
     curCycleRFReads = 0;
     curCycleIssuedUops = 0;
 
-    instrs = 0;
-
     // initilize instruction window
     insWindow = gm_memalign<WindowStructure>(CACHE_LINE_BYTES);
     insWindow = new (insWindow) WindowStructure(8192, ooo_params.ins_win_cap);
@@ -83,33 +69,15 @@ void IssueModel::initStats(AggregateStat* parentStat) {
     AggregateStat* coreStat = new AggregateStat();
     coreStat->init(name.c_str(), "Core stats");
 
-    auto x = [this]() { return cRec.getUnhaltedCycles(curCycle); };
-    LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
-    cyclesStat->init("cycles", "Simulated unhalted cycles");
-
-    auto y = [this]() { return cRec.getContentionCycles(); };
-    LambdaStat<decltype(y)>* cCyclesStat = new LambdaStat<decltype(y)>(y);
-    cCyclesStat->init("cCycles", "Cycles due to contention stalls");
-
-    ProxyStat* pcountStat = new ProxyStat();
-    pcountStat->init("pcount", "Simulated instructions", &total_pcount);
-    ProxyStat* icountStat = new ProxyStat();
-    icountStat->init("icount", "Simulated instructions", &total_icount);
     profIssueStalls = new Counter();
     profIssueStalls->init("issueStalls",  "Issue stalls");  
 
-    coreStat->append(cyclesStat);
-    coreStat->append(cCyclesStat);
-    coreStat->append(icountStat);
-    coreStat->append(pcountStat);
+    initTimingStats(coreStat);
     coreStat->append(profIssueStalls);
 
     parentStat->append(coreStat);
 }
 
-uint64_t IssueModel::getInstrs() const {return instrs;}
-uint64_t IssueModel::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
-
 void IssueModel::contextSwitch(int32_t gid) {
     if (gid == -1) {
         // Do not execute previous BBL, as we were context-switched
@@ -118,7 +86,7 @@ void IssueModel::contextSwitch(int32_t gid) {
 }
 
 
-InstrFuncPtrs IssueModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc, BranchFunc, PredLoadFunc, PredStoreFunc, FPTR_ANALYSIS, {0}};}
+InstrFuncPtrs IssueModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc<IssueModel>, BranchFunc, PredLoadFunc, PredStoreFunc, MemBufFunc, FPTR_ANALYSIS};}
 
 inline void IssueModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
     if (!prevBbl) {
@@ -135,14 +103,12 @@ inline void IssueModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
     uint32_t loadIdx = 0;
     uint32_t storeIdx = 0;
 
-    uint32_t prevDecCycle = 0;
-
     // Run dispatch/IW
     for (uint32_t i = 0; i < bbl->uops; i++) {
         DynUop* uop = &(bbl->uop[i]);
 
         // Decode stalls
-        uint32_t decDiff = uop->decCycle - prevDecCycle;
+        uint32_t decDiff = uop->decDiff;
         decodeCycle = MAX(decodeCycle + decDiff, uopQueue->minAllocCycle());
         if (decodeCycle > curCycle) {
             uint32_t cdDiff = decodeCycle - curCycle;
@@ -150,7 +116,6 @@ inline void IssueModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
             curCycleRFReads = 0;
             for (uint32_t i = 0; i < cdDiff; i++) insWindow->advancePos(curCycle);
         }
-        prevDecCycle = uop->decCycle;
         uopQueue->markLeave(curCycle);
 
         // Implement issue width limit --- we can only issue 4 uops/cycle
@@ -282,38 +247,7 @@ inline void IssueModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
     instrs += bblInstrs;
     assert(instrs == total_pcount);
 
-    if(interval_icount >= (uint64_t)interval_size) {
-        cerr << "interval_icount: " << interval_icount << " total_icount: " << total_icount <<endl;
-        zinfo -> periodicStatsBackend -> dump(false);// flushes trace writer
-        interval_icount = 0;
-        interval_pcount = 0;
-    }
-}
-
-// Timing simulation code
-void IssueModel::join() {
-    DEBUG_MSG("[%s] Joining, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-    uint64_t targetCycle = cRec.notifyJoin(curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-    phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
-    DEBUG_MSG("[%s] Joined, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-}
-
-void IssueModel::leave() {
-    DEBUG_MSG("[%s] Leaving, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
-    cRec.notifyLeave(curCycle);
-}
-
-void IssueModel::cSimStart() {
-    uint64_t targetCycle = cRec.cSimStart(curCycle);
-    assert(targetCycle >= curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
-}
-
-void IssueModel::cSimEnd() {
-    uint64_t targetCycle = cRec.cSimEnd(curCycle);
-    assert(targetCycle >= curCycle);
-    if (targetCycle > curCycle) advance(targetCycle);
+    endOfBbl();
 }
 
 void IssueModel::advance(uint64_t targetCycle) {
@@ -335,25 +269,6 @@ void IssueModel::LoadFunc(THREADID tid, ADDRINT addr) {}
 void IssueModel::StoreFunc(THREADID tid, ADDRINT addr) {}
 void IssueModel::PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred) {}
 void IssueModel::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {}
-
-void IssueModel::BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
-    IssueModel* core = static_cast<IssueModel*>(cores[tid]);
-    core->bbl(bblAddr, bblInfo, tid);
-
-    while (core->curCycle > core->phaseEndCycle) {
-        core->phaseEndCycle += zinfo->phaseLength;
-
-        uint32_t cid = getCid(tid);
-        // NOTE: TakeBarrier may take ownership of the core, and so it will be used by some other thread. If TakeBarrier context-switches us,
-        // the *only* safe option is to return inmmediately after we detect this, or we can race and corrupt core state. However, the information
-        // here is insufficient to do that, so we could wind up double-counting phases.
-        uint32_t newCid = TakeBarrier(tid, cid);
-        // NOTE: Upon further observation, we cannot race if newCid == cid, so this code should be enough.
-        // It may happen that we had an intervening context-switch and we are now back to the same core.
-        // This is fine, since the loop looks at core values directly and there are no locals involved,
-        // so we should just advance as needed and move on.
-        if (newCid != cid) break;  /*context-switch, we do not own this context anymore*/
-    }
-}
+void IssueModel::MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n) {}
 
 void IssueModel::BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {}
\ No newline at end of file
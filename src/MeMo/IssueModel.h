@@ -26,19 +26,16 @@
 #ifndef ISSUE_CORE_H
 #define ISSUE_CORE_H
 
+#include "MeMoCore.h"
 #include "legos.h"
 
-class IssueModel : public Core {
+class IssueModel : public MeMoTimingCore {
     private:
         const uint32_t ooo_width;
         const uint32_t ooo_prf_ports;
 
-        uint64_t phaseEndCycle; //next stopping point
-
-        uint64_t curCycle; //this model is issue-centric; curCycle refers to the current issue cycle
-        uint64_t regScoreboard[MAX_REGISTERS]; //contains timestamp of next issue cycles where each reg can be sourced
-
-        BblInfo* prevBbl;
+        // curCycle is issue-centric; it refers to the current issue cycle
+        uint64_t regScoreboard[MAX_UOP_REGS]; //contains timestamp of next issue cycles where each reg can be sourced
 
         Counter* profIssueStalls;
 
@@ -73,12 +70,9 @@ class IssueModel : public Core {
         ReorderBuffer* rob;
         // ReorderBuffer<128, 4> rob;
 
-        uint64_t decodeCycle;
         CycleQueue* uopQueue;  // models issue queue
         // CycleQueue<28> uopQueue;  // models issue queue
 
-        uint64_t instrs;
-
         // Load-store forwarding
         // Just a direct-mapped array of last store cycles to 4B-wide blocks
         // (i.e., indexed by (addr >> 2) & (FWD_ENTRIES-1))
@@ -91,39 +85,21 @@ class IssueModel : public Core {
         #define FWD_ENTRIES 32  // 2 lines, 16 4B entries/line
         FwdEntry fwdArray[FWD_ENTRIES];
 
-        OOOCoreRecorder cRec;
-
     public:
         IssueModel(const OOOParams& oo_params, g_string& _name);
 
         void initStats(AggregateStat* parentStat);
 
-        uint64_t getInstrs() const;
-        uint64_t getPhaseCycles() const;
-        uint64_t getCycles() const {return cRec.getUnhaltedCycles(curCycle);}
-
         void contextSwitch(int32_t gid);
 
-        virtual void join();
-        virtual void leave();
-
         InstrFuncPtrs GetFuncPtrs();
-
-        // Contention simulation interface
-        inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
-        void cSimStart();
-        void cSimEnd();
+        uint32_t GetInstrReqs() const {return 0;}
 
     private:
-        /* NOTE: Analysis routines cannot touch curCycle directly, must use
-         * advance() for long jumps or insWindow.advancePos() for 1-cycle
-         * jumps.
-         *
-         * UPDATE: With decodeCycle, this difference is more serious. ONLY
-         * cSimStart and cSimEnd should call advance(). advance() is now meant
-         * to advance the cycle counters in the whole core in lockstep.
-         */
-        inline void advance(uint64_t targetCycle);
+        friend class MeMoCore;  // calls bbl()
+
+        // Also advances the instruction window
+        void advance(uint64_t targetCycle);
 
         inline void bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid);
 
@@ -131,7 +107,7 @@ class IssueModel : public Core {
         static void StoreFunc(THREADID tid, ADDRINT addr);
         static void PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred);
         static void PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred);
-        static void BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo);
+        static void MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n);
         static void BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc);
 } ATTR_LINE_ALIGNED;  // Take up an int number of cache lines
 
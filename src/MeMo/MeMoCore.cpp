@@ -0,0 +1,139 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MeMoCore.h"
+#include <iostream>
+#include "bbv_profiler.h"
+#include "bithacks.h"
+#include "profile_stats.h"
+#include "stats.h"
+#include "telemetry.h"
+
+#define DEBUG_MSG(args...)
+//#define DEBUG_MSG(args...) info(args)
+
+MeMoCore::MeMoCore(g_string& _name) : Core(_name), phaseEndCycle(zinfo->phaseLength), curCycle(0), instrs(0) {}
+
+uint64_t MeMoCore::getPhaseCycles() const {return curCycle % zinfo->phaseLength;}
+
+void MeMoCore::join() {
+    DEBUG_MSG("[%s] Joining, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
+    curCycle = MAX(curCycle, zinfo->globPhaseCycles);
+    phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
+    DEBUG_MSG("[%s] Joined, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
+}
+
+void MeMoCore::initInstrStats(AggregateStat* coreStat) {
+    ProxyStat* pcountStat = new ProxyStat();
+    pcountStat->init("pcount", "Simulated instructions", &total_pcount);
+    ProxyStat* icountStat = new ProxyStat();
+    icountStat->init("icount", "Simulated instructions", &total_icount);
+
+    coreStat->append(icountStat);
+    coreStat->append(pcountStat);
+}
+
+void MeMoCore::endOfSlice() {
+    std::cerr << "interval_icount: " << interval_icount << " total_icount: " << total_icount << std::endl;
+    uint64_t dumpStartNs = getNs();
+    {
+        HOST_PROF_SCOPE(HP_STATS_DUMP);
+        zinfo->periodicStatsBackend->dump(false);  // flushes trace writer
+        if (zinfo->bbvProfiler) zinfo->bbvProfiler->dump();
+    }
+    TelemetrySliceDone(total_icount, getNs() - dumpStartNs);
+    interval_icount = 0;
+    interval_pcount = 0;
+}
+
+void MeMoCore::takeBarriers(THREADID tid) {
+    while (curCycle > phaseEndCycle) {
+        phaseEndCycle += zinfo->phaseLength;
+
+        uint32_t cid = getCid(tid);
+        // NOTE: TakeBarrier may take ownership of the core, and so it will be used by some other thread. If TakeBarrier context-switches us,
+        // the *only* safe option is to return inmmediately after we detect this, or we can race and corrupt core state. However, the information
+        // here is insufficient to do that, so we could wind up double-counting phases.
+        uint32_t newCid = TakeBarrier(tid, cid);
+        // NOTE: Upon further observation, we cannot race if newCid == cid, so this code should be enough.
+        // It may happen that we had an intervening context-switch and we are now back to the same core.
+        // This is fine, since the loop looks at core values directly and there are no locals involved,
+        // so we should just advance as needed and move on.
+        if (newCid != cid) break;  /*context-switch, we do not own this context anymore*/
+    }
+}
+
+MeMoTimingCore::MeMoTimingCore(g_string& _name, uint64_t _decodeCycle)
+    : MeMoCore(_name), decodeCycle(_decodeCycle), prevBbl(nullptr), cRec(0, _name) {}
+
+void MeMoTimingCore::initTimingStats(AggregateStat* coreStat) {
+    auto x = [this]() { return cRec.getUnhaltedCycles(curCycle); };
+    LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
+    cyclesStat->init("cycles", "Simulated unhalted cycles");
+
+    auto y = [this]() { return cRec.getContentionCycles(); };
+    LambdaStat<decltype(y)>* cCyclesStat = new LambdaStat<decltype(y)>(y);
+    cCyclesStat->init("cCycles", "Cycles due to contention stalls");
+
+    coreStat->append(cyclesStat);
+    coreStat->append(cCyclesStat);
+    initInstrStats(coreStat);
+}
+
+// Timing simulation code
+void MeMoTimingCore::join() {
+    DEBUG_MSG("[%s] Joining, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
+    uint64_t targetCycle = cRec.notifyJoin(curCycle);
+    if (targetCycle > curCycle) advance(targetCycle);
+    phaseEndCycle = zinfo->globPhaseCycles + zinfo->phaseLength;
+    DEBUG_MSG("[%s] Joined, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
+}
+
+void MeMoTimingCore::leave() {
+    DEBUG_MSG("[%s] Leaving, curCycle %ld phaseEnd %ld", name.c_str(), curCycle, phaseEndCycle);
+    cRec.notifyLeave(curCycle);
+}
+
+void MeMoTimingCore::cSimStart() {
+    uint64_t targetCycle = cRec.cSimStart(curCycle);
+    assert(targetCycle >= curCycle);
+    if (targetCycle > curCycle) advance(targetCycle);
+}
+
+void MeMoTimingCore::cSimEnd() {
+    uint64_t targetCycle = cRec.cSimEnd(curCycle);
+    assert(targetCycle >= curCycle);
+    if (targetCycle > curCycle) advance(targetCycle);
+}
+
+void MeMoTimingCore::advance(uint64_t targetCycle) {
+    assert(targetCycle > curCycle);
+    decodeCycle += targetCycle - curCycle;
+    curCycle = targetCycle;
+    /* NOTE: Validation with weave mems shows that not advancing internal cycle
+     * counters in e.g., the ROB does not change much; consider full-blown
+     * rebases though if weave models fail to validate for some app.
+     */
+}
@@ -0,0 +1,132 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMO_CORE_H
+#define MEMO_CORE_H
+
+#include "core.h"
+#include "host_prof.h"
+#include "ooo_core_recorder.h"
+#include "pad.h"
+#include "zsim.h"
+
+// Slice and instruction counters, defined in zsim.cpp
+extern int64_t  interval_size;
+extern uint64_t interval_pcount;
+extern uint64_t interval_icount;
+extern uint64_t total_pcount;
+extern uint64_t total_icount;
+
+/* Common base of the MeMo micro-models: phase tracking, the barrier loop run
+ * after every BBL, and periodic (slice) stats dumps.
+ *
+ * Dispatch is static. Models expose BblFunc<Model> in their GetFuncPtrs(),
+ * which calls Model::bbl() directly (models befriend MeMoCore so it can).
+ * bbl() must advance curCycle and instrs, and call endOfBbl() at its end.
+ */
+class MeMoCore : public Core {
+    protected:
+        uint64_t phaseEndCycle; //next stopping point
+        uint64_t curCycle;
+        uint64_t instrs;
+
+    public:
+        explicit MeMoCore(g_string& _name);
+
+        uint64_t getInstrs() const {return instrs;}
+        uint64_t getPhaseCycles() const;
+        uint64_t getCycles() const {return curCycle;}
+
+        virtual void join();
+        virtual void leave() {}
+
+    protected:
+        // Appends the pcount and icount stats
+        void initInstrStats(AggregateStat* coreStat);
+
+        // Dumps periodic stats if the current slice is full
+        static inline void endOfBbl() {
+            if (unlikely(interval_icount >= (uint64_t)interval_size)) endOfSlice();
+        }
+
+        template <typename T>
+        static void BblFunc(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+            T* core = static_cast<T*>(cores[tid]);
+            {
+                HOST_PROF_SCOPE(HP_MODEL_BBL);
+                core->bbl(bblAddr, bblInfo, tid);
+            }
+            if (unlikely(core->curCycle > core->phaseEndCycle)) core->takeBarriers(tid);
+        }
+
+    private:
+        static void endOfSlice();
+        void takeBarriers(THREADID tid);
+};
+
+/* MeMo models with a timing model, whose memory accesses and stalls are
+ * recorded with an OOOCoreRecorder and simulated in the weave phase.
+ *
+ * ContentionSim builds the list of these cores once, at init, and calls the
+ * (non-virtual) cSimStart/cSimEnd hooks on them every phase.
+ */
+class MeMoTimingCore : public MeMoCore {
+    protected:
+        uint64_t decodeCycle;
+        BblInfo* prevBbl;
+
+        OOOCoreRecorder cRec;
+
+    public:
+        MeMoTimingCore(g_string& _name, uint64_t _decodeCycle);
+
+        uint64_t getCycles() const {return cRec.getUnhaltedCycles(curCycle);}
+
+        virtual void join();
+        virtual void leave();
+
+        // Contention simulation interface
+        inline EventRecorder* getEventRecorder() {return cRec.getEventRecorder();}
+        void cSimStart();
+        void cSimEnd();
+
+    protected:
+        // Appends the cycles, cCycles, pcount and icount stats
+        void initTimingStats(AggregateStat* coreStat);
+
+        /* NOTE: Analysis routines cannot touch curCycle directly, must use
+         * advance() for long jumps or insWindow.advancePos() for 1-cycle
+         * jumps.
+         *
+         * UPDATE: With decodeCycle, this difference is more serious. ONLY
+         * cSimStart and cSimEnd should call advance(). advance() is now meant
+         * to advance the cycle counters in the whole core in lockstep.
+         *
+         * Virtual, but only called on joins and contention-induced delays.
+         */
+        virtual void advance(uint64_t targetCycle);
+};
+
+#endif  // MEMO_CORE_H
@@ -0,0 +1,187 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ReuseModel.h"
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "bithacks.h"
+#include "hash.h"
+#include "zsim.h"
+
+#define DEBUG_MSG(args...)
+//#define DEBUG_MSG(args...) info(args)
+
+ReuseModel::ReuseModel(uint32_t _maxSamples, double samplingRate, g_string& _name)
+    : MeMoCore(_name), maxSamples(_maxSamples), window(4*_maxSamples)
+{
+    if (samplingRate <= 0.0 || samplingRate > 1.0) panic("%s: samplingRate must be in (0, 1], is %f", name.c_str(), samplingRate);
+    if (maxSamples < 16) panic("%s: maxSamples must be at least 16, is %d", name.c_str(), maxSamples);
+    hf = new H3HashFamily(1, 32, 0x5EEDBEEF);
+    threshold = MAX((uint64_t)1, (uint64_t)(samplingRate*(1 << REUSE_HASH_BITS)));
+
+    fenwick = gm_calloc<uint32_t>(window + 1);
+    now = 1;
+
+    for (uint32_t i = 0; i < REUSE_BINS; i++) hist[i] = 0.0;
+    accesses = 0;
+    sampledAccesses = 0;
+}
+
+void ReuseModel::initStats(AggregateStat* parentStat) {
+    AggregateStat* coreStat = new AggregateStat();
+    coreStat->init(name.c_str(), "Core stats");
+
+    auto x = [this]() { return curCycle; };
+    LambdaStat<decltype(x)>* cyclesStat = new LambdaStat<decltype(x)>(x);
+    cyclesStat->init("cycles", "Simulated cycles (1 per instruction)");
+
+    ProxyStat* accessesStat = new ProxyStat();
+    accessesStat->init("accesses", "Memory accesses", &accesses);
+    ProxyStat* sampledStat = new ProxyStat();
+    sampledStat->init("sampledAccesses", "Memory accesses sampled by SHARDS", &sampledAccesses);
+
+    auto r = [this]() { return (threshold*1000000) >> REUSE_HASH_BITS; };
+    LambdaStat<decltype(r)>* rateStat = new LambdaStat<decltype(r)>(r);
+    rateStat->init("samplingRate", "Current SHARDS sampling rate (ppm)");
+
+    auto h = [this](uint32_t i) { return (uint64_t)hist[i]; };
+    LambdaVectorStat<decltype(h)>* histStat = new LambdaVectorStat<decltype(h)>(h, REUSE_BINS);
+    histStat->init("reuseDist", "Estimated accesses per log2 reuse distance bin (lines; 0: d=0, i: [2^(i-1), 2^i), last: cold)");
+
+    coreStat->append(cyclesStat);
+    initInstrStats(coreStat);
+    coreStat->append(accessesStat);
+    coreStat->append(sampledStat);
+    coreStat->append(rateStat);
+    coreStat->append(histStat);
+
+    parentStat->append(coreStat);
+}
+
+InstrFuncPtrs ReuseModel::GetFuncPtrs() {return {LoadFunc, StoreFunc, BblFunc<ReuseModel>, BranchFunc, PredLoadFunc, PredStoreFunc, MemBufFunc, FPTR_ANALYSIS};}
+
+inline void ReuseModel::access(Address addr) {
+    accesses++;
+    Address lineAddr = addr >> lineBits;
+    uint64_t h = hf->hash(0, lineAddr) & ((1 << REUSE_HASH_BITS) - 1);
+    if (h < threshold) sampledAccess(lineAddr);
+}
+
+void ReuseModel::sampledAccess(Address lineAddr) {
+    if (now > window) compact();
+
+    double scale = ((double)(1 << REUSE_HASH_BITS))/threshold;
+    uint32_t bin;
+    g_unordered_map<Address, uint32_t>::iterator it = lastAccess.find(lineAddr);
+    if (it != lastAccess.end()) {
+        uint32_t ts = it->second;
+        uint64_t dist = fenwickSum(now - 1) - fenwickSum(ts);  // distinct lines touched since last access
+        fenwickAdd(ts, -1);
+        it->second = now;
+        uint64_t estDist = (uint64_t)(dist*scale);
+        bin = estDist? MIN(ilog2(estDist) + 1, (uint32_t)REUSE_BINS - 2) : 0;
+    } else {
+        lastAccess[lineAddr] = now;
+        bin = REUSE_BINS - 1;
+    }
+    fenwickAdd(now, 1);
+    now++;
+
+    hist[bin] += scale;
+    sampledAccesses++;
+
+    if (lastAccess.size() > maxSamples) lowerThreshold();
+}
+
+// Fixed-size SHARDS: lower the threshold so that 7/8 of maxSamples lines remain, evict the rest
+void ReuseModel::lowerThreshold() {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(lastAccess.size());
+    for (auto& kv : lastAccess) hashes.push_back(kv.first);
+    hf->hashN(0, hashes.data(), hashes.data(), hashes.size());  // in place
+    for (uint64_t& h : hashes) h &= (1 << REUSE_HASH_BITS) - 1;
+    uint32_t keep = maxSamples*7/8;
+    std::nth_element(hashes.begin(), hashes.begin() + keep, hashes.end());
+    uint64_t newThreshold = hashes[keep];
+    assert(newThreshold < threshold);
+    DEBUG_MSG("[%s] Lowering SHARDS threshold %ld -> %ld", name.c_str(), threshold, newThreshold);
+    threshold = MAX((uint64_t)1, newThreshold);
+
+    for (auto it = lastAccess.begin(); it != lastAccess.end();) {
+        if ((hf->hash(0, it->first) & ((1 << REUSE_HASH_BITS) - 1)) >= threshold) {
+            fenwickAdd(it->second, -1);
+            it = lastAccess.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+// Renumber live timestamps densely from 1, preserving their order
+void ReuseModel::compact() {
+    std::vector<std::pair<uint32_t, Address>> live;
+    live.reserve(lastAccess.size());
+    for (auto& kv : lastAccess) live.push_back(std::make_pair(kv.second, kv.first));
+    std::sort(live.begin(), live.end());
+
+    for (uint32_t i = 0; i <= window; i++) fenwick[i] = 0;
+    now = 1;
+    for (auto& p : live) {
+        lastAccess[p.second] = now;
+        fenwickAdd(now, 1);
+        now++;
+    }
+}
+
+inline void ReuseModel::bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid) {
+    instrs += bblInfo->instrs;
+    curCycle += bblInfo->instrs;
+
+    endOfBbl();
+}
+
+// Pin interface code
+
+void ReuseModel::LoadFunc(THREADID tid, ADDRINT addr) {static_cast<ReuseModel*>(cores[tid])->access(addr);}
+void ReuseModel::StoreFunc(THREADID tid, ADDRINT addr) {static_cast<ReuseModel*>(cores[tid])->access(addr);}
+
+void ReuseModel::PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred) {
+    if (pred) static_cast<ReuseModel*>(cores[tid])->access(addr);
+}
+
+void ReuseModel::PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred) {
+    if (pred) static_cast<ReuseModel*>(cores[tid])->access(addr);
+}
+
+void ReuseModel::MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n) {
+    ReuseModel* core = static_cast<ReuseModel*>(cores[tid]);
+    for (uint32_t i = 0; i < n; i++) {
+        Address addr = addrs[i] & ~MEMBUF_STORE;
+        if (addr != MEMBUF_PRED_FALSE) core->access(addr);
+    }
+}
+
+void ReuseModel::BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {}
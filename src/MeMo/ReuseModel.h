@@ -0,0 +1,113 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REUSE_CORE_H
+#define REUSE_CORE_H
+
+#include "g_std/g_unordered_map.h"
+#include "g_std/g_vector.h"
+#include "MeMoCore.h"
+#include "legos.h"
+
+class HashFamily;
+
+// Log2-binned reuse distances: bin 0 is distance 0, bin i is [2^(i-1), 2^i), last bin is cold misses
+#define REUSE_BINS 32
+#define REUSE_HASH_BITS 24
+
+/* Reuse-distance micro-model: computes line-granularity LRU stack distances
+ * over the load/store stream, from which the miss-ratio curve of a fully
+ * associative LRU cache of any size follows.
+ *
+ * Uses fixed-size SHARDS sampling (Waldspurger et al., FAST'15): a line is
+ * sampled iff hash(line) < threshold, and when more than maxSamples lines are
+ * tracked, the threshold is lowered and lines above it are evicted. So memory
+ * and time per access are bounded regardless of the footprint. Sampled
+ * distances and counts are scaled by 1/rate.
+ *
+ * Stack distances are computed with a Fenwick tree over last-access
+ * timestamps (a line's distance is the number of distinct lines accessed
+ * after its previous access); timestamps are compacted when the window fills.
+ */
+class ReuseModel : public MeMoCore {
+    private:
+        // No timing model: curCycle advances one cycle per instruction
+
+        // SHARDS state
+        HashFamily* hf;
+        uint64_t threshold;  // sample iff hash < threshold, out of 1 << REUSE_HASH_BITS
+        const uint32_t maxSamples;
+        g_unordered_map<Address, uint32_t> lastAccess;  // sampled line -> timestamp
+
+        // Fenwick tree over timestamps [1, window]; a 1 marks the last access of a tracked line
+        uint32_t* fenwick;
+        const uint32_t window;
+        uint32_t now;
+
+        // Scaled (estimated) counts; fractional because 1/rate need not be an integer
+        double hist[REUSE_BINS];
+        uint64_t accesses;
+        uint64_t sampledAccesses;
+
+    public:
+        ReuseModel(uint32_t _maxSamples, double samplingRate, g_string& _name);
+
+        void initStats(AggregateStat* parentStat);
+
+        void contextSwitch(int32_t gid) {}
+
+        InstrFuncPtrs GetFuncPtrs();
+        uint32_t GetInstrReqs() const {return INSTR_REQ_MEM;}
+
+    private:
+        friend class MeMoCore;  // calls bbl()
+
+        inline void access(Address addr);
+        void sampledAccess(Address lineAddr);
+
+        void lowerThreshold();
+        void compact();
+
+        inline void fenwickAdd(uint32_t ts, int32_t v) {
+            for (; ts <= window; ts += ts & -ts) fenwick[ts] += v;
+        }
+
+        inline uint32_t fenwickSum(uint32_t ts) const {  // sum over [1, ts]
+            uint32_t s = 0;
+            for (; ts; ts -= ts & -ts) s += fenwick[ts];
+            return s;
+        }
+
+        inline void bbl(Address bblAddr, BblInfo* bblInfo, THREADID tid);
+
+        static void LoadFunc(THREADID tid, ADDRINT addr);
+        static void StoreFunc(THREADID tid, ADDRINT addr);
+        static void PredLoadFunc(THREADID tid, ADDRINT addr, BOOL pred);
+        static void PredStoreFunc(THREADID tid, ADDRINT addr, BOOL pred);
+        static void MemBufFunc(THREADID tid, const ADDRINT* addrs, uint32_t n);
+        static void BranchFunc(THREADID tid, ADDRINT pc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc);
+} ATTR_LINE_ALIGNED;  // Take up an int number of cache lines
+
+#endif  // REUSE_CORE_H
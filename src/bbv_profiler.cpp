@@ -0,0 +1,82 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bbv_profiler.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+BBVProfiler::BBVProfiler(const char* outputDir, uint32_t _maxBbls, uint32_t _projDims, uint64_t _projSeed)
+    : maxBbls(_maxBbls), projDims(_projDims), projSeed(_projSeed)
+{
+    entries = gm_calloc<Entry>(maxBbls + 1);
+    touched = gm_calloc<uint32_t>(maxBbls + 1);
+    numTouched = 0;
+    overflowWarned = false;
+    epoch = 1;
+    slices = 0;
+
+    std::string pathStr = outputDir;
+    bbvFile = gm_strdup((pathStr + "/zsim.bbv").c_str());
+    std::ofstream(bbvFile, std::ios_base::out);  // truncate
+    if (projDims) {
+        projFile = gm_strdup((pathStr + "/zsim.bbvproj").c_str());
+        std::ofstream(projFile, std::ios_base::out);
+    } else {
+        projFile = nullptr;
+    }
+    info("BBV profiling enabled, %d max BBLs, %d projected dims", maxBbls, projDims);
+}
+
+void BBVProfiler::dump() {
+    std::ofstream out(bbvFile, std::ios_base::app);
+    out << "T";
+    uint64_t sliceInstrs = 0;
+    for (uint32_t i = 0; i < numTouched; i++) {
+        uint32_t idx = touched[i];
+        out << ":" << idx << ":" << entries[idx].count << " ";
+        sliceInstrs += entries[idx].count;
+    }
+    out << std::endl;
+
+    if (projDims) {
+        std::vector<double> proj(projDims, 0.0);
+        if (sliceInstrs) {
+            for (uint32_t i = 0; i < numTouched; i++) {
+                uint32_t idx = touched[i];
+                double freq = ((double)entries[idx].count)/sliceInstrs;
+                for (uint32_t d = 0; d < projDims; d++) proj[d] += freq*projCoeff(idx, d);
+            }
+        }
+        std::ofstream pout(projFile, std::ios_base::app);
+        pout.precision(9);
+        for (uint32_t d = 0; d < projDims; d++) pout << (d? " " : "") << proj[d];
+        pout << std::endl;
+    }
+
+    slices++;
+    epoch++;
+    numTouched = 0;
+}
@@ -0,0 +1,111 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BBV_PROFILER_H_
+#define BBV_PROFILER_H_
+
+#include <stdint.h>
+#include "galloc.h"
+#include "log.h"
+
+/* Per-slice basic-block vector (BBV) collector, for SimPoint-style baselines.
+ *
+ * Counts are instruction-weighted and indexed by the dense bblIdx the decoder
+ * assigns. Each entry is tagged with the epoch (slice) it was last touched in,
+ * so a stale entry reads as zero and starting a new slice is O(1); the touched
+ * list makes dumping O(touched) instead of O(static BBLs).
+ *
+ * Every slice is appended to <outputDir>/zsim.bbv in SimPoint frequency-vector
+ * format. If projDims > 0, the normalized vector is also randomly projected to
+ * projDims dimensions (as SimPoint does internally) and appended to
+ * <outputDir>/zsim.bbvproj, one dense row per slice.
+ *
+ * bblIdx grows with every (re)decoded BBL, e.g., after code cache flushes or
+ * with JIT code, so long runs can exceed sim.bbv.maxBbls. Those BBLs are
+ * counted together in an overflow bucket, dimension maxBbls, with a warning
+ * the first time; size maxBbls so this bucket stays small.
+ *
+ * NOTE: Counts are not updated atomically; like FFI, this assumes a
+ * single-threaded process, which is how MeMo profiling runs.
+ */
+class BBVProfiler : public GlobAlloc {
+    private:
+        struct Entry {
+            uint64_t count;
+            uint64_t epoch;
+        };
+
+        Entry* entries;
+        uint32_t* touched;
+        uint32_t numTouched;
+        const uint32_t maxBbls;  // entries[maxBbls] is the overflow bucket
+        bool overflowWarned;
+        uint64_t epoch;  // starts at 1, entries start zeroed (i.e., stale)
+
+        const uint32_t projDims;
+        const uint64_t projSeed;
+
+        const char* bbvFile;
+        const char* projFile;
+
+        uint64_t slices;
+
+    public:
+        BBVProfiler(const char* outputDir, uint32_t _maxBbls, uint32_t _projDims, uint64_t _projSeed);
+
+        inline void record(uint32_t bblIdx, uint32_t instrs) {
+            if (unlikely(bblIdx >= maxBbls)) {
+                if (!overflowWarned) {
+                    warn("BBV: bblIdx %d exceeds sim.bbv.maxBbls (%d); counting BBLs past it in overflow bucket %d", bblIdx, maxBbls, maxBbls);
+                    overflowWarned = true;
+                }
+                bblIdx = maxBbls;
+            }
+            Entry& e = entries[bblIdx];
+            if (e.epoch != epoch) {
+                e.epoch = epoch;
+                e.count = 0;
+                touched[numTouched++] = bblIdx;
+            }
+            e.count += instrs;
+        }
+
+        // Appends the current slice's vector(s) to the output files and starts a new slice
+        void dump();
+
+    private:
+        // Deterministic projection coefficient in [-1, 1) for (bblIdx, dim); avoids storing a maxBbls x projDims matrix
+        inline double projCoeff(uint32_t bblIdx, uint32_t dim) const {
+            uint64_t x = projSeed ^ ((((uint64_t)bblIdx) << 32) | dim);
+            // splitmix64 finalizer
+            x += 0x9E3779B97F4A7C15ULL;
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+            x = x ^ (x >> 31);
+            return ((double)(x >> 11)) / ((double)(1ULL << 52)) - 1.0;
+        }
+};
+
+#endif  // BBV_PROFILER_H_
@@ -26,6 +26,7 @@
 #include "contention_sim.h"
 #include <algorithm>
 #include <queue>
+#include <stdio.h>
 #include <sstream>
 #include <string>
 #include <typeinfo>
@@ -33,9 +34,8 @@
 #include <vector>
 #include "log.h"
 #include "legos.h"
-#include "CacheModel.h"
-#include "FetchModel.h"
-#include "IssueModel.h"
+#include "MeMoCore.h"
+#include "placement.h"
 #include "timing_event.h"
 #include "zsim.h"
 
@@ -60,9 +60,11 @@ void ContentionSim::SimThreadTrampoline(void* arg) {
     csim->simThreadLoop(thid);
 }
 
-ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
+ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads, uint32_t _inlineWeaveEvents, bool _stealDomains) {
     numDomains = _numDomains;
     numSimThreads = _numSimThreads;
+    inlineWeaveEvents = _inlineWeaveEvents;
+    stealDomains = _stealDomains && numSimThreads > 1;
     threadsDone = 0;
     limit = 0;
     lastLimit = 0;
@@ -75,6 +77,10 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
         new (&domains[i].pq) PrioQueue<TimingEvent, PQ_BLOCKS>();
         domains[i].curCycle = 0;
         futex_init(&domains[i].pqLock);
+        domains[i].stealReq = NO_THIEF;
+#if TRACE_PQ
+        new (&domains[i].pqTrace) g_vector<uint64_t>();
+#endif
     }
 
     if ((numDomains % numSimThreads) != 0) panic("numDomains(%d) must be a multiple of numSimThreads(%d) for now", numDomains, numSimThreads);
@@ -84,6 +90,7 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
         futex_lock(&simThreads[i].wakeLock); //starts locked, so first actual call to lock blocks
         simThreads[i].firstDomain = i*numDomains/numSimThreads;
         simThreads[i].supDomain = (i+1)*numDomains/numSimThreads;
+        for (uint32_t d = simThreads[i].firstDomain; d < simThreads[i].supDomain; d++) domains[d].owner = i;
     }
 
     futex_init(&waitLock);
@@ -103,24 +110,12 @@ ContentionSim::ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads) {
 }
 
 void ContentionSim::postInit() {
+    // Done once here, so that simulatePhase() needs no RTTI
     for (uint32_t i = 0; i < zinfo->numCores; i++) {
-        CacheModel *ccore = dynamic_cast<CacheModel*>(zinfo->cores[i]);
-        if (ccore) {
-            skipContention = false;
-            return;
-        }
-        FetchModel *fcore = dynamic_cast<FetchModel*>(zinfo->cores[i]);
-        if (fcore) {
-            skipContention = false;
-            return;
-        }
-        IssueModel *icore = dynamic_cast<IssueModel*>(zinfo->cores[i]);
-        if (icore) {
-            skipContention = false;
-            return;
-        }
+        MeMoTimingCore* core = dynamic_cast<MeMoTimingCore*>(zinfo->cores[i]);
+        if (core) timingCores.push_back(core);
     }
-    skipContention = true;
+    skipContention = timingCores.empty();
 }
 
 void ContentionSim::initStats(AggregateStat* parentStat) {
@@ -147,6 +142,14 @@ void ContentionSim::initStats(AggregateStat* parentStat) {
         domStat->append(&domains[i].profTime);
         objStat->append(domStat);
     }
+    profInlinePhases.init("inlinePhases", "Phases with little weave work, simulated without waking up the sim threads");
+    profEmptyPhases.init("emptyPhases", "Phases with no weave work, skipped");
+    objStat->append(&profInlinePhases);
+    objStat->append(&profEmptyPhases);
+    if (stealDomains) {
+        profStolenDomains.init("stolenDomains", "Domains taken over by idle sim threads");
+        objStat->append(&profStolenDomains);
+    }
     parentStat->append(objStat);
 }
 
@@ -157,37 +160,53 @@ void ContentionSim::simulatePhase(uint64_t limit) {
     assert(limit >= lastLimit);
 
     //info("simulatePhase limit %ld", limit);
-    for (uint32_t i = 0; i < zinfo->numCores; i++) {
-        CacheModel *ccore = dynamic_cast<CacheModel*>(zinfo->cores[i]);
-        if (ccore) ccore->cSimStart();
-        FetchModel *fcore = dynamic_cast<FetchModel*>(zinfo->cores[i]);
-        if (fcore) fcore->cSimStart();
-        IssueModel *icore = dynamic_cast<IssueModel*>(zinfo->cores[i]);
-        if (icore) icore->cSimStart();
+    for (MeMoTimingCore* core : timingCores) core->cSimStart();
+
+    //Most phases in compute-bound stretches only carry the cores' issue event
+    //chains; waking up the sim threads costs more than simulating those here.
+    //This is equivalent to running with a single sim thread for this phase.
+    uint64_t queuedEvents = 0;
+    for (uint32_t i = 0; i < numDomains; i++) {
+        queuedEvents += domains[i].pq.size();
     }
 
     inCSim = true;
     __sync_synchronize();
 
-    //Wake up sim threads
-    for (uint32_t i = 0; i < numSimThreads; i++) {
-        futex_unlock(&simThreads[i].wakeLock);
-    }
+    if (queuedEvents == 0) {
+        for (uint32_t i = 0; i < numDomains; i++) domains[i].curCycle = limit;
+        profEmptyPhases.inc();
+    } else if (queuedEvents <= inlineWeaveEvents) {
+        simulatePhaseThread(0, 0, numDomains, true);
+        profInlinePhases.inc();
+    } else {
+        if (stealDomains) {
+            //Domains go back to their home threads every phase
+            for (uint32_t i = 0; i < numSimThreads; i++) {
+                SimThreadData& st = simThreads[i];
+                st.activeDomains = st.supDomain - st.firstDomain;
+                for (uint32_t d = st.firstDomain; d < st.supDomain; d++) {
+                    domains[d].owner = i;
+                    domains[d].phaseDone = false;
+                    assert(domains[d].stealReq == NO_THIEF);
+                }
+            }
+            __sync_synchronize();
+        }
 
-    //Sleep until phase is simulated
-    futex_lock_nospin(&waitLock);
+        //Wake up sim threads
+        for (uint32_t i = 0; i < numSimThreads; i++) {
+            futex_unlock(&simThreads[i].wakeLock);
+        }
+
+        //Sleep until phase is simulated
+        futex_lock_nospin(&waitLock);
+    }
 
     inCSim = false;
     __sync_synchronize();
 
-    for (uint32_t i = 0; i < zinfo->numCores; i++) {
-        CacheModel* ccore = dynamic_cast<CacheModel*>(zinfo->cores[i]);
-        if (ccore) ccore->cSimEnd();
-        FetchModel* fcore = dynamic_cast<FetchModel*>(zinfo->cores[i]);
-        if (fcore) fcore->cSimEnd();
-        IssueModel* icore = dynamic_cast<IssueModel*>(zinfo->cores[i]);
-        if (icore) icore->cSimEnd();
-    }
+    for (MeMoTimingCore* core : timingCores) core->cSimEnd();
 
     lastLimit = limit;
     __sync_synchronize();
@@ -201,12 +220,12 @@ void ContentionSim::enqueue(TimingEvent* ev, uint64_t cycle) {
     assert_msg(cycle < lastLimit+10*zinfo->phaseLength+1000000, "Queued event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
 
     assert_msg(cycle >= domains[ev->domain].curCycle, "Queued event goes back in time, cycle %ld curCycle %ld", cycle, domains[ev->domain].curCycle);
-    ev->privCycle = cycle;
     assert(ev->numParents == 0);
     assert(ev->domain != -1);
     assert(ev->domain < (int32_t)numDomains);
 
     domains[ev->domain].pq.enqueue(ev, cycle);
+    tracePQ(&domains[ev->domain], cycle);
 }
 
 void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) {
@@ -220,9 +239,9 @@ void ContentionSim::enqueueSynced(TimingEvent* ev, uint64_t cycle) {
     assert_msg(cycle >= lastLimit, "Enqueued (synced) event before last limit! cycle %ld min %ld", cycle, lastLimit);
     //Hacky, but helpful to chase events scheduled too far ahead due to bugs (e.g., cycle -1). We should probably formalize this a bit more
     assert_msg(cycle < lastLimit+10*zinfo->phaseLength+10000, "Queued  (synced) event too far into the future, cycle %ld lastLimit %ld", cycle, lastLimit);
-    ev->privCycle = cycle;
     assert(ev->numParents == 0);
     domains[ev->domain].pq.enqueue(ev, cycle);
+    tracePQ(&domains[ev->domain], cycle);
 
     futex_unlock(&domains[domain].pqLock);
 }
@@ -267,18 +286,7 @@ void ContentionSim::enqueueCrossing(CrossingEvent* ev, uint64_t cycle, uint32_t
 
 void ContentionSim::simThreadLoop(uint32_t thid) {
     info("Started contention simulation thread %d", thid);
-#if 0
-    //Pin
-    uint32_t nprocs = sysconf(_SC_NPROCESSORS_ONLN);
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    //CPU_SET(domain % nprocs, cpuset); //basically no difference
-    //CPU_SET(0, cpuset); CPU_SET(1, cpuset); CPU_SET(2, cpuset); CPU_SET(3, cpuset); //don't use hyperthreads; confuses the scheduler to no end, does worse
-    CPU_SET(thid % nprocs, &cpuset); CPU_SET((thid % nprocs) + (nprocs/2), &cpuset); //pin to a single core but can use both its hyperthreads, works best (~20% gain)
-    //TODO: Must make this optional, or multiple simulations/machine will work horribly
-    int r = sched_setaffinity(0 /*calling thread, equiv to syscall(SYS_gettid)*/, sizeof(cpuset), &cpuset);
-    assert_msg(r == 0, "sched_setaffinity failed (%d)", r);
-#endif
+    if (zinfo->placement) zinfo->placement->placeContentionThread(thid);
     while (true) {
         futex_lock_nospin(&simThreads[thid].wakeLock);
 
@@ -287,7 +295,13 @@ void ContentionSim::simThreadLoop(uint32_t thid) {
         }
 
         //info("%d --- phase start", domain);
-        simulatePhaseThread(thid);
+        simulatePhaseThread(thid, simThreads[thid].firstDomain, simThreads[thid].supDomain, false);
+        if (stealDomains) {
+            while (DomainData* domain = stealDomain(thid)) {
+                std::vector<DomainData*> doms(1, domain);
+                simulateDomains(thid, doms, false);
+            }
+        }
         //info("%d --- phase end", domain);
 
         uint32_t val = __sync_add_and_fetch(&threadsDone, 1);
@@ -299,18 +313,20 @@ void ContentionSim::simThreadLoop(uint32_t thid) {
     info("Finished contention simulation thread %d", thid);
 }
 
-void ContentionSim::simulatePhaseThread(uint32_t thid) {
-    uint32_t thDomains = simThreads[thid].supDomain - simThreads[thid].firstDomain;
-    uint32_t numFinished = 0;
+//inlineWeave: called from simulatePhase with the sim threads asleep; there are no thieves, and the
+//steal bookkeeping (activeDomains, owner, phaseDone) is only set up for threaded phases, so skip it
+void ContentionSim::simulatePhaseThread(uint32_t thid, uint32_t firstDomain, uint32_t supDomain, bool inlineWeave) {
+    uint32_t thDomains = supDomain - firstDomain;
 
     if (thDomains == 1) {
-        DomainData& domain = domains[simThreads[thid].firstDomain];
+        DomainData& domain = domains[firstDomain];
         domain.profTime.start();
         PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain.pq;
         while (pq.size() && pq.firstCycle() < limit) {
             uint64_t domCycle = domain.curCycle;
             uint64_t cycle;
             TimingEvent* te = pq.dequeue(cycle);
+            tracePQ(&domain, PQ_TRACE_DEQUEUE);
             assert(cycle >= domCycle);
             if (cycle != domCycle) {
                 domCycle = cycle;
@@ -324,7 +340,7 @@ void ContentionSim::simulatePhaseThread(uint32_t thid) {
             simThreads[thid].logVec.push_back(std::make_pair(cycle, te));
 #endif
         }
-        domain.curCycle = limit;
+        finishDomain(thid, &domain, inlineWeave);
         domain.profTime.end();
 
 #if POST_MORTEM
@@ -358,67 +374,171 @@ void ContentionSim::simulatePhaseThread(uint32_t thid) {
 
     } else {
         //info("XXX %d / %d %d %d", thid, thDomains, simThreads[thid].supDomain, simThreads[thid].firstDomain);
-
-        std::priority_queue<DomainData*, std::vector<DomainData*>, CompareDomains> domPq;
-        for (uint32_t i = simThreads[thid].firstDomain; i < simThreads[thid].supDomain; i++) {
-            domPq.push(&domains[i]);
+        std::vector<DomainData*> doms;
+        for (uint32_t i = firstDomain; i < supDomain; i++) {
+            doms.push_back(&domains[i]);
         }
+        simulateDomains(thid, doms, inlineWeave);
+    }
 
-        std::vector<DomainData*> sq1;
-        std::vector<DomainData*> sq2;
-
-        std::vector<DomainData*>& stalledQueue = sq1;
-        std::vector<DomainData*>& nextStalledQueue = sq2;
-
-        while (numFinished < thDomains) {
-            while (domPq.size()) {
-                DomainData* domain = domPq.top();
-                domPq.pop();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
-                if (!pq.size() || pq.firstCycle() > limit) {
-                    numFinished++;
-                    domain->curCycle = limit;
-                } else {
-                    //info("YYY %d %ld %ld %d", numFinished, domPq.size(), domain->curCycle, domain->prio);
-                    uint64_t cycle;
-                    TimingEvent* te = pq.dequeue(cycle);
-                    //uint64_t nextCycle = pq.size()? pq.firstCycle() : cycle;
-                    if (cycle != domain->curCycle) domain->curCycle = cycle;
-                    te->run(cycle);
-                    domain->curCycle = pq.size()? pq.firstCycle() : limit;
-                    domain->queuePrio = domain->curCycle;
-                    if (domain->prio == 0) domPq.push(domain);
-                    else stalledQueue.push_back(domain);
-                }
+    //info("Phase done");
+    __sync_synchronize();
+}
+
+void ContentionSim::simulateDomains(uint32_t thid, std::vector<DomainData*>& doms, bool inlineWeave) {
+    uint32_t thDomains = doms.size();
+    uint32_t numFinished = 0;
+
+    std::priority_queue<DomainData*, std::vector<DomainData*>, CompareDomains> domPq;
+    for (DomainData* domain : doms) {
+        domPq.push(domain);
+    }
+
+    std::vector<DomainData*> sq1;
+    std::vector<DomainData*> sq2;
+
+    std::vector<DomainData*>& stalledQueue = sq1;
+    std::vector<DomainData*>& nextStalledQueue = sq2;
+
+    while (numFinished < thDomains) {
+        while (domPq.size()) {
+            DomainData* domain = domPq.top();
+            domPq.pop();
+            PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
+            if (domain->stealReq != NO_THIEF) {
+                handOffDomain(thid, domain);
+                numFinished++;
+            } else if (!pq.size() || pq.firstCycle() > limit) {
+                numFinished++;
+                finishDomain(thid, domain, inlineWeave);
+            } else {
+                //info("YYY %d %ld %ld %d", numFinished, domPq.size(), domain->curCycle, domain->prio);
+                uint64_t cycle;
+                TimingEvent* te = pq.dequeue(cycle);
+                tracePQ(domain, PQ_TRACE_DEQUEUE);
+                //uint64_t nextCycle = pq.size()? pq.firstCycle() : cycle;
+                if (cycle != domain->curCycle) domain->curCycle = cycle;
+                te->run(cycle);
+                domain->curCycle = pq.size()? pq.firstCycle() : limit;
+                domain->queuePrio = domain->curCycle;
+                if (domain->prio == 0) domPq.push(domain);
+                else stalledQueue.push_back(domain);
             }
+        }
 
-            while (stalledQueue.size()) {
-                DomainData* domain = stalledQueue.back();
-                stalledQueue.pop_back();
-                PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
-                if (!pq.size() || pq.firstCycle() > limit) {
-                    numFinished++;
-                    domain->curCycle = limit;
-                } else {
-                    //info("SSS %d %ld %ld", numFinished, stalledQueue.size(), domain->curCycle);
-                    uint64_t cycle;
-                    TimingEvent* te = pq.dequeue(cycle);
-                    if (cycle != domain->curCycle) domain->curCycle = cycle;
-                    te->state = EV_RUNNING;
-                    te->simulate(cycle);
-                    domain->curCycle = pq.size()? pq.firstCycle() : limit;
-                    domain->queuePrio = domain->curCycle;
-                    if (domain->prio == 0) domPq.push(domain);
-                    else nextStalledQueue.push_back(domain);
-                }
-                if (domPq.size()) break;
+        while (stalledQueue.size()) {
+            DomainData* domain = stalledQueue.back();
+            stalledQueue.pop_back();
+            PrioQueue<TimingEvent, PQ_BLOCKS>& pq = domain->pq;
+            if (domain->stealReq != NO_THIEF) {
+                handOffDomain(thid, domain);
+                numFinished++;
+            } else if (!pq.size() || pq.firstCycle() > limit) {
+                numFinished++;
+                finishDomain(thid, domain, inlineWeave);
+            } else {
+                //info("SSS %d %ld %ld", numFinished, stalledQueue.size(), domain->curCycle);
+                uint64_t cycle;
+                TimingEvent* te = pq.dequeue(cycle);
+                tracePQ(domain, PQ_TRACE_DEQUEUE);
+                if (cycle != domain->curCycle) domain->curCycle = cycle;
+                te->state = EV_RUNNING;
+                te->simulate(cycle);
+                domain->curCycle = pq.size()? pq.firstCycle() : limit;
+                domain->queuePrio = domain->curCycle;
+                if (domain->prio == 0) domPq.push(domain);
+                else nextStalledQueue.push_back(domain);
             }
-            if (!stalledQueue.size()) std::swap(stalledQueue, nextStalledQueue);
+            if (domPq.size()) break;
         }
+        if (!stalledQueue.size()) std::swap(stalledQueue, nextStalledQueue);
     }
+}
 
-    //info("Phase done");
+void ContentionSim::finishDomain(uint32_t thid, DomainData* domain, bool inlineWeave) {
+    domain->curCycle = limit;
+    if (!stealDomains || inlineWeave) return;
+    domain->phaseDone = true;
+    __sync_fetch_and_sub(&simThreads[thid].activeDomains, 1);
     __sync_synchronize();
+    //A thief may have posted a request after our last check; turn it down
+    domain->stealReq = NO_THIEF;
+}
+
+//Operations on a domain's queue are serialized (pqLock in the bound phase, the owner in the weave phase)
+void ContentionSim::tracePQ(DomainData* domain, uint64_t op) {
+#if TRACE_PQ
+    if (domain->pqTraceDone) return;
+    domain->pqTrace.push_back(op);
+    if (domain->pqTrace.size() < PQ_TRACE_OPS) return;
+
+    domain->pqTraceDone = true;
+    std::stringstream ss;
+    ss << zinfo->outputDir << "/pqtrace-" << (domain - domains) << ".bin";
+    FILE* f = fopen(ss.str().c_str(), "w");
+    if (!f || fwrite(&domain->pqTrace[0], sizeof(uint64_t), domain->pqTrace.size(), f) != domain->pqTrace.size()) {
+        warn("Could not write %s", ss.str().c_str());
+    } else {
+        info("Dumped %ld queue operations to %s", domain->pqTrace.size(), ss.str().c_str());
+    }
+    if (f) fclose(f);
+    domain->pqTrace.clear();
+    domain->pqTrace.shrink_to_fit();
+#endif
+}
+
+void ContentionSim::handOffDomain(uint32_t thid, DomainData* domain) {
+    //Called between events, so the thief sees the domain's queue as we left it
+    uint32_t thief = domain->stealReq;
+    assert(thief != NO_THIEF && thief != thid);
+    __sync_fetch_and_sub(&simThreads[thid].activeDomains, 1);
+    __sync_synchronize();
+    domain->owner = thief;
+    __sync_synchronize();
+    domain->stealReq = NO_THIEF;
+}
+
+/* Called by a sim thread that has run out of domains for this phase. Picks
+ * the thread with the most unfinished domains (taking the only domain of a
+ * thread gains nothing), asks for one of them, and waits until the owner
+ * hands it over between events or finishes it. Ownership only changes
+ * hands at the owner's side, so a domain never runs on two threads and
+ * crossings see the same curCycle progression as with static assignment.
+ */
+ContentionSim::DomainData* ContentionSim::stealDomain(uint32_t thid) {
+    while (true) {
+        uint32_t victim = NO_THIEF;
+        uint32_t maxActive = 1;
+        for (uint32_t i = 0; i < numSimThreads; i++) {
+            uint32_t active = simThreads[i].activeDomains;
+            if (i != thid && active > maxActive) {
+                victim = i;
+                maxActive = active;
+            }
+        }
+        if (victim == NO_THIEF) return nullptr;
+
+        for (uint32_t d = 0; d < numDomains; d++) {
+            DomainData* domain = &domains[d];
+            if (domain->owner != victim || domain->phaseDone) continue;
+            if (!__sync_bool_compare_and_swap(&domain->stealReq, NO_THIEF, thid)) continue;
+            __sync_synchronize();
+            if (domain->owner != victim || domain->phaseDone) {
+                //Finished or moved before our request was posted; it may never be checked again
+                __sync_bool_compare_and_swap(&domain->stealReq, thid, NO_THIEF);
+                continue;
+            }
+
+            while (domain->stealReq == thid) _mm_pause();
+            __sync_synchronize();
+            if (domain->owner == thid) {
+                __sync_fetch_and_add(&simThreads[thid].activeDomains, 1);
+                profStolenDomains.atomicInc();
+                return domain;
+            }
+            break;  //turned down (finished); pick a victim again
+        }
+    }
 }
 
 void ContentionSim::finish() {
@@ -43,12 +43,21 @@
 #define PROFILE_CROSSINGS 0
 //#define PROFILE_CROSSINGS 1
 
+//Set to 1 to dump the first PQ_TRACE_OPS queue operations of every domain to pqtrace-<domain>.bin
+//in the output dir, to benchmark PrioQueue changes on real event times (see pq_bench.cpp)
+#define TRACE_PQ 0
+//#define TRACE_PQ 1
+#define PQ_TRACE_OPS (1 << 24)
+
 class TimingEvent;
 class DelayEvent;
 class CrossingEvent;
+class MeMoTimingCore;
 
 #define PQ_BLOCKS 1024
 
+#define NO_THIEF ((uint32_t)-1)
+
 class ContentionSim : public GlobAlloc {
     private:
         struct CompareEvents : public std::binary_function<TimingEvent*, TimingEvent*, bool> {
@@ -71,6 +80,12 @@ class ContentionSim : public GlobAlloc {
             lock_t pqLock; //used on phase 1 enqueues
             //lock_t domainLock; //used by simulation thread
 
+            //Work stealing (reset every phase). Only the owner runs the domain's events;
+            //a thief posts stealReq, and the owner hands the domain over between events.
+            volatile uint32_t owner;
+            volatile uint32_t stealReq; //NO_THIEF if none
+            volatile bool phaseDone;
+
             uint32_t prio;
             uint64_t queuePrio;
 
@@ -78,6 +93,11 @@ class ContentionSim : public GlobAlloc {
 
             ClockStat profTime;
 
+#if TRACE_PQ
+            g_vector<uint64_t> pqTrace; //enqueue cycles, or PQ_TRACE_DEQUEUE
+            bool pqTraceDone;
+#endif
+
 #if PROFILE_CROSSINGS
             VectorCounter profIncomingCrossingSims;
             VectorCounter profIncomingCrossings;
@@ -93,6 +113,7 @@ class ContentionSim : public GlobAlloc {
             lock_t wakeLock; //used to sleep/wake up simulation thread
             uint32_t firstDomain;
             uint32_t supDomain; //supreme, ie first not included
+            volatile uint32_t activeDomains; //owned and not yet done this phase; read by thieves
 
             std::vector<std::pair<uint64_t, TimingEvent*> > logVec;
         };
@@ -107,6 +128,18 @@ class ContentionSim : public GlobAlloc {
         uint32_t numSimThreads;
         bool skipContention;
 
+        g_vector<MeMoTimingCore*> timingCores;  // cores with cSimStart/cSimEnd hooks, built in postInit()
+
+        // Phases with at most this many queued events are simulated by the calling thread, without waking up the sim threads
+        uint32_t inlineWeaveEvents;
+
+        // Idle sim threads take over unfinished domains from threads that still have several
+        bool stealDomains;
+
+        Counter profInlinePhases;
+        Counter profEmptyPhases;
+        Counter profStolenDomains;
+
         PAD();
 
         //RW
@@ -126,7 +159,7 @@ class ContentionSim : public GlobAlloc {
         lock_t postMortemLock;
 
     public:
-        ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads);
+        ContentionSim(uint32_t _numDomains, uint32_t _numSimThreads, uint32_t _inlineWeaveEvents, bool _stealDomains);
 
         void initStats(AggregateStat* parentStat);
 
@@ -161,7 +194,13 @@ class ContentionSim : public GlobAlloc {
 
     private:
         void simThreadLoop(uint32_t thid);
-        void simulatePhaseThread(uint32_t thid);
+        void simulatePhaseThread(uint32_t thid, uint32_t firstDomain, uint32_t supDomain, bool inlineWeave);
+        void simulateDomains(uint32_t thid, std::vector<DomainData*>& doms, bool inlineWeave);
+
+        void finishDomain(uint32_t thid, DomainData* domain, bool inlineWeave);
+        void tracePQ(DomainData* domain, uint64_t op);
+        void handOffDomain(uint32_t thid, DomainData* domain);
+        DomainData* stealDomain(uint32_t thid);
 
         static void SimThreadTrampoline(void* arg);
 };
@@ -35,6 +35,11 @@ struct BblInfo {
     uint32_t bblIdx;
     uint32_t instrs;
     uint32_t bytes;
+    // If the BBL ends in a conditional branch whose outcome can be inferred from the next BBL
+    // executed (see Decoder::isInferableBranch), its pc and targets; brPc == 0 otherwise
+    uint64_t brPc;
+    uint64_t brTakenNpc;
+    uint64_t brNotTakenNpc;
     DynBbl oooBbl[0]; //0 bytes, but will be 1-sized when we have an element (and that element has variable size as well)
 };
 
@@ -49,8 +54,9 @@ struct InstrFuncPtrs {  // NOLINT(whitespace)
     // Same as load/store functions, but last arg indicated whether op is executing
     void (*predLoadPtr)(THREADID, ADDRINT, BOOL);
     void (*predStorePtr)(THREADID, ADDRINT, BOOL);
+    // Buffered capture (used instead of the 4 above): all accesses since the previous BBL callback, in program order
+    void (*memBufPtr)(THREADID, const ADDRINT*, uint32_t);
     uint64_t type;
-    uint64_t pad[1];
     //NOTE: By having the struct be a power of 2 bytes, indirect calls are simpler (w/ gcc 4.4 -O3, 6->5 instructions, and those instructions are simpler)
 };
 
@@ -61,6 +67,29 @@ struct InstrFuncPtrs {  // NOLINT(whitespace)
 #define FPTR_NOP (2L)
 #define FPTR_RETRY (3L)
 
+//Instrumentation requirements: the analysis callbacks a core type consumes (see Core::GetInstrReqs)
+#define INSTR_REQ_MEM (1 << 0)      // load/store addresses, including predicated ones
+#define INSTR_REQ_BRANCH (1 << 1)   // conditional branch outcomes
+#define INSTR_REQ_ALL (INSTR_REQ_MEM | INSTR_REQ_BRANCH)
+
+/* Buffered memory address capture (sim.bufferMemAddrs): inlined instrumentation
+ * writes each access to a per-thread buffer, which is handed to memBufPtr in bulk
+ * just before the next BBL callback. Entries are addresses, tagged with
+ * MEMBUF_STORE for stores; predicated-off accesses are MEMBUF_PRED_FALSE (plus the
+ * store tag). The tag takes the top address bit, which user-space addresses never
+ * have; the writers clear it, so the few user-readable kernel-half addresses (the
+ * legacy vsyscall page) are simulated as their bit-63-cleared alias rather than
+ * misread as stores. BBLs that could overflow the buffer or the models' per-BBL
+ * arrays (REP instructions, or more than MEMBUF_MAX_LOADS loads or
+ * MEMBUF_MAX_STORES stores) use the per-access callbacks instead, see
+ * CanBufferMem() in zsim.cpp.
+ */
+#define MEMBUF_STORE (1ul << 63)
+#define MEMBUF_PRED_FALSE (~MEMBUF_STORE)
+#define MEMBUF_MAX_LOADS 256   // models keep at most 256 loads and 256 stores per BBL
+#define MEMBUF_MAX_STORES 256
+#define MEMBUF_ENTRIES (MEMBUF_MAX_LOADS + MEMBUF_MAX_STORES)
+
 //Generic core class
 
 class Core : public GlobAlloc {
@@ -86,6 +115,10 @@ class Core : public GlobAlloc {
         virtual void join() {}
 
         virtual InstrFuncPtrs GetFuncPtrs() = 0;
+
+        //Callbacks this core type needs; the code cache is shared by all cores, so the
+        //process instruments the union over cores, and skips callbacks no core uses
+        virtual uint32_t GetInstrReqs() const {return INSTR_REQ_ALL;}
 };
 
 #endif  // CORE_H_
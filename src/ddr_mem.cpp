@@ -173,6 +173,8 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
 
     rdQueue.init(queueDepth);
     wrQueue.init(queueDepth);
+    overflowQueue.init(queueDepth);
+    nextQueueSeq = 0;
 
     info("%s: domain %d, %d ranks/ch %d banks/rank, tech %s, boundLat %d rd / %d wr",
             name.c_str(), domain, ranksPerChannel, banksPerRank, tech, minRdLatency, minWrLatency);
@@ -181,6 +183,9 @@ DDRMemory::DDRMemory(uint32_t _lineSize, uint32_t _colSize, uint32_t _ranksPerCh
 
     banks.resize(ranksPerChannel);
     for (uint32_t i = 0; i < ranksPerChannel; i++) banks[i].resize(banksPerRank);
+    uint32_t bmapWords = (ranksPerChannel*banksPerRank + 63)/64;
+    rdPendingBanks.resize(bmapWords, 0);
+    wrPendingBanks.resize(bmapWords, 0);
 
     rankActWindows.resize(ranksPerChannel);
     for (uint32_t i = 0; i < ranksPerChannel; i++) rankActWindows[i].init(4);  // we only model FAW; for TAW (other technologies) change this to 2
@@ -298,10 +303,9 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
     DEBUG("%ld: enqueue() addr 0x%lx wr %d", memCycle, ev->getAddr(), ev->isWrite());
 
     // Create request
-    Request ovfReq;
     bool overflow = rdQueue.full() || wrQueue.full();
     bool useWrQueue = deferredWrites && ev->isWrite();
-    Request* req = overflow? &ovfReq : useWrQueue? wrQueue.alloc() : rdQueue.alloc();
+    Request* req = overflow? overflowQueue.alloc() : useWrQueue? wrQueue.alloc() : rdQueue.alloc();
 
     req->addr = ev->getAddr();
     req->loc = mapLineAddr(ev->getAddr());
@@ -313,9 +317,7 @@ void DDRMemory::enqueue(DDRMemoryAccEvent* ev, uint64_t sysCycle) {
     req->ev = ev;
     ev->hold();
 
-    if (overflow) {
-        overflowQueue.push_back(*req);
-    } else {
+    if (!overflow) {
         queue(req, memCycle);
 
         // If needed, schedule an event to handle this new request
@@ -354,19 +356,21 @@ void DDRMemory::queue(Request* req, uint64_t memCycle) {
     }
 
     req->arrivalCycle = memCycle;  // if this comes from the overflow queue, update
+    req->queueSeq = nextQueueSeq++;
 
     // Test: Skip writes
 #if 0
     if (req->write) {
-        assert(wrQueue.size() == 1);
-        wrQueue.remove(wrQueue.begin());
+        wrQueue.free(req);
         return;
     }
 #endif
 
     // Alloc in per-bank queue, in FR order
     Bank& bank = banks[req->loc.rank][req->loc.bank];
-    InList<Request>& q = (deferredWrites && req->write)? bank.wrReqs : bank.rdReqs;
+    bool useWrQueue = deferredWrites && req->write;
+    InList<Request>& q = useWrQueue? bank.wrReqs : bank.rdReqs;
+    setPending(useWrQueue? wrPendingBanks : rdPendingBanks, bankIdx(req->loc));
 
     // Print bak queue? Use to verify FR-FCFS
 #if 0
@@ -430,11 +434,11 @@ uint64_t DDRMemory::tick(uint64_t sysCycle) {
     uint64_t minSchedCycle = trySchedule(memCycle, sysCycle);
     assert(minSchedCycle >= memCycle);
     if (!rdQueue.full() && !wrQueue.full() && !overflowQueue.empty()) {
-        Request& ovfReq = overflowQueue.front();
-        bool useWrQueue = deferredWrites && ovfReq.write;
+        Request* ovfReq = overflowQueue.dequeue();
+        bool useWrQueue = deferredWrites && ovfReq->write;
         Request* req = useWrQueue? wrQueue.alloc() : rdQueue.alloc();
-        *req = ovfReq;
-        overflowQueue.pop_front();
+        *req = *ovfReq;  // both unlinked, so this does not copy list state
+        overflowQueue.release(ovfReq);
 
         queue(req, memCycle);
 
@@ -513,24 +517,26 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     RequestQueue<Request>& queue = isWriteQueue? wrQueue : rdQueue;
     assert(!queue.empty());
 
+    /* Only the head of each bank queue can issue, so instead of walking the
+     * whole queue in arrival order, walk the banks with pending requests and
+     * pick the oldest ready head. This picks the same request as a scan in
+     * arrival order, in O(ranks*banks) instead of O(queueDepth).
+     */
+    const g_vector<uint64_t>& pendingBanks = isWriteQueue? wrPendingBanks : rdPendingBanks;
     Request* r = nullptr;
-    RequestQueue<Request>::iterator ir = queue.begin();
     uint64_t minSchedCycle = -1ul;
-    while (ir != queue.end()) {
-        //Bank& bank = banks[(*ir)->loc.rank][(*ir)->loc.bank];
-        //if ((isWriteQueue? bank.wrReqs : bank.rdReqs).front() == *ir) {
-        if (!(*ir)->prev) {  // FASTAH!
-            uint64_t minCmdCycle = findMinCmdCycle(**ir);
+    for (uint32_t w = 0; w < pendingBanks.size(); w++) {
+        uint64_t bits = pendingBanks[w];
+        while (bits) {
+            uint32_t idx = w*64 + __builtin_ctzl(bits);
+            bits &= bits - 1;
+            Bank& bank = banks[idx / banksPerRank][idx % banksPerRank];
+            Request* head = (isWriteQueue? bank.wrReqs : bank.rdReqs).front();
+            assert(head);
+            uint64_t minCmdCycle = findMinCmdCycle(*head);
             minSchedCycle = std::min(minSchedCycle, minCmdCycle);
-            if (minCmdCycle <= curCycle) {
-                r = *ir;
-                break;
-            }
-            //DEBUG("Skipping 0x%lx, not ready %ld", (*ir)->ev->getAddr(), minCmdCycle);
-        } else {
-            //DEBUG("Skipping 0x%lx, not first", (*ir)->ev->getAddr());
+            if (minCmdCycle <= curCycle && (!r || head->queueSeq < r->queueSeq)) r = head;
         }
-        ir.inc();
     }
 
     if (!r) {
@@ -625,8 +631,11 @@ uint64_t DDRMemory::trySchedule(uint64_t curCycle, uint64_t sysCycle) {
     DEBUG("Served 0x%lx lat %ld clocks", r->addr, minRespCycle-curCycle);
 
     // Dequeue this req
-    queue.remove(ir);
-    (isWriteQueue? bank.wrReqs : bank.rdReqs).pop_front();
+    InList<Request>& bankQueue = isWriteQueue? bank.wrReqs : bank.rdReqs;
+    assert(bankQueue.front() == r);
+    bankQueue.pop_front();
+    if (bankQueue.empty()) clearPending(isWriteQueue? wrPendingBanks : rdPendingBanks, bankIdx(r->loc));
+    queue.free(r);
 
     return (rdQueue.empty() && wrQueue.empty())? -1ul : minRespCycle - tCL;
 }
@@ -26,8 +26,6 @@
 #ifndef DDR_MEM_H_
 #define DDR_MEM_H_
 
-#include <deque>
-
 #include "g_std/g_string.h"
 #include "intrusive_list.h"
 #include "memory_hierarchy.h"
@@ -103,54 +101,94 @@ class ActWindow {
         inline uint32_t dec(uint32_t i) const { return i? i-1 : buf.size()-1; }
 };
 
-// Read or write queues, ordered/inserted by arrival time, out-of-order finish
+/* Bounded pool of read or write requests. Allocated requests live in the
+ * per-bank queues (which hold the FR-FCFS order), so elements must be
+ * InListNodes, and a request is either in a bank queue or in our free list.
+ */
 template <typename T>
 class RequestQueue {
     private:
-        struct Node : InListNode<Node> {
-            T elem;
-        };
-        InList<Node> reqList;  // FIFO
-        InList<Node> freeList; // LIFO (higher locality)
+        InList<T> freeList; // LIFO (higher locality)
+        size_t elems;
 
     public:
+        RequestQueue() : elems(0) {}
+
         void init(size_t size) {
-            assert(reqList.empty() && freeList.empty());
-            Node* buf = gm_calloc<Node>(size);
+            assert(!elems && freeList.empty());
+            T* buf = gm_calloc<T>(size);
             for (uint32_t i = 0; i < size; i++) {
-                new (&buf[i]) Node();
+                new (&buf[i]) T();
                 freeList.push_back(&buf[i]);
             }
         }
 
-        inline bool empty() const { return reqList.empty(); }
+        inline bool empty() const { return !elems; }
         inline bool full() const { return freeList.empty(); }
-        inline size_t size() const { return reqList.size(); }
+        inline size_t size() const { return elems; }
 
         inline T* alloc() {
             assert(!full());
-            Node* n = freeList.back();
+            T* e = freeList.back();
             freeList.pop_back();
-            reqList.push_back(n);
-            return &n->elem;
+            elems++;
+            return e;
         }
 
-        struct iterator {
-            Node* n;
-            explicit inline iterator(Node* _n) : n(_n) {}
-            inline void inc() {n = n->next;}  // overloading prefix/postfix too messy
-            inline T* operator*() const { return &(n->elem); }
-            inline bool operator==(const iterator& it) const { return it.n == n; }
-            inline bool operator!=(const iterator& it) const { return it.n != n; }
-        };
+        inline void free(T* e) {
+            assert(elems);
+            freeList.push_back(e);
+            elems--;
+        }
+};
+
+/* FIFO of requests that did not fit in the read/write queues. Backed by a
+ * free list that grows in chunks, so it never returns memory and its
+ * footprint is bounded by the high-water mark of overflowed requests.
+ */
+template <typename T>
+class OverflowQueue {
+    private:
+        InList<T> reqList;  // FIFO
+        InList<T> freeList; // LIFO
+        size_t chunkSize;
+
+    public:
+        OverflowQueue() : chunkSize(0) {}
+
+        void init(size_t _chunkSize) {
+            assert(_chunkSize);
+            chunkSize = _chunkSize;
+        }
+
+        inline bool empty() const { return reqList.empty(); }
+        inline size_t size() const { return reqList.size(); }
+
+        inline T* alloc() {
+            if (freeList.empty()) {
+                assert(chunkSize);
+                T* buf = gm_calloc<T>(chunkSize);
+                for (uint32_t i = 0; i < chunkSize; i++) {
+                    new (&buf[i]) T();
+                    freeList.push_back(&buf[i]);
+                }
+            }
+            T* e = freeList.back();
+            freeList.pop_back();
+            reqList.push_back(e);
+            return e;
+        }
 
-        inline iterator begin() const {return iterator(reqList.front());}
-        inline iterator end() const {return iterator(nullptr);}
+        // Unlinks the oldest request; caller must release() it when done
+        inline T* dequeue() {
+            T* e = reqList.front();
+            assert(e);
+            reqList.pop_front();
+            return e;
+        }
 
-        inline void remove(iterator i) {
-            assert(i.n);
-            reqList.remove(i.n);
-            freeList.push_back(i.n);
+        inline void release(T* e) {
+            freeList.push_back(e);
         }
 };
 
@@ -174,6 +212,7 @@ class DDRMemory : public MemObject {
             bool write;
 
             uint64_t rowHitSeq; // sequence number used to throttle max # row hits
+            uint64_t queueSeq;  // order of insertion in the rd/wr queues, for FCFS across banks
 
             // Cycle accounting
             uint64_t arrivalCycle;  // in memCycles
@@ -245,9 +284,14 @@ class DDRMemory : public MemObject {
         uint32_t preDelay, postDelayRd, postDelayWr;
 
         RequestQueue<Request> rdQueue, wrQueue;
-        std::deque<Request> overflowQueue;
+        OverflowQueue<Request> overflowQueue;
+        uint64_t nextQueueSeq;
 
         g_vector< g_vector<Bank> > banks; // indexed by rank, bank
+
+        // Bitmaps of banks with non-empty rdReqs/wrReqs, indexed by rank*banksPerRank + bank.
+        // The scheduler only needs to look at the head of each of these banks.
+        g_vector<uint64_t> rdPendingBanks, wrPendingBanks;
         g_vector<ActWindow> rankActWindows;
 
         // Event scheduling
@@ -305,6 +349,10 @@ class DDRMemory : public MemObject {
     private:
         AddrLoc mapLineAddr(Address lineAddr);
 
+        inline uint32_t bankIdx(const AddrLoc& loc) const { return loc.rank*banksPerRank + loc.bank; }
+        inline void setPending(g_vector<uint64_t>& bmap, uint32_t idx) { bmap[idx >> 6] |= 1ul << (idx & 63); }
+        inline void clearPending(g_vector<uint64_t>& bmap, uint32_t idx) { bmap[idx >> 6] &= ~(1ul << (idx & 63)); }
+
         void queue(Request* req, uint64_t memCycle);
 
         inline uint64_t trySchedule(uint64_t curCycle, uint64_t sysCycle);
@@ -30,8 +30,11 @@
 #include <iostream>
 #include <string.h>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include "bithacks.h"
 #include "core.h"
+#include "host_prof.h"
 #include "locks.h"
 #include "log.h"
 #include "BasicBlockMap.h"
@@ -60,8 +63,57 @@ static uint32_t bblIdx = 1;
 
 #define PORTS_015 (PORT_0 | PORT_1 | PORT_5)
 
-void DynUop::clear() {
-    memset(this, 0, sizeof(DynUop));  // NOTE: This may break if DynUop becomes non-POD
+void DecUop::clear() {
+    memset(this, 0, sizeof(DecUop));  // NOTE: This may break if DecUop becomes non-POD
+}
+
+/* Finalization */
+
+/* Dense register ids, assigned in order of first use. Like bbl_map, these are
+ * only touched while decoding BBLs, which PIN serializes.
+ */
+static uint8_t denseRegs[MAX_REGISTERS];
+static uint32_t numDenseRegs = 1;  // 0 is the invalid reg
+
+uint8_t Decoder::mapReg(uint32_t reg) {
+    if (!reg) return 0;
+    assert(reg < MAX_REGISTERS);
+    if (unlikely(!denseRegs[reg])) {
+        if (numDenseRegs == MAX_UOP_REGS) panic("Decoder: more than %d distinct registers, increase MAX_UOP_REGS", MAX_UOP_REGS - 1);
+        denseRegs[reg] = numDenseRegs++;
+    }
+    return denseRegs[reg];
+}
+
+void Decoder::packUop(const DecUop& in, uint32_t prevDecCycle, DynUop& out) {
+    for (uint32_t i = 0; i < MAX_UOP_SRC_REGS; i++) out.rs[i] = mapReg(in.rs[i]);
+    for (uint32_t i = 0; i < MAX_UOP_DST_REGS; i++) out.rd[i] = mapReg(in.rd[i]);
+    assert(in.lat < 256 && in.type < 16);
+    out.lat = in.lat;
+    out.extraSlots = in.extraSlots;
+    out.portMask = in.portMask;
+    out.type = in.type;
+    assert(in.decCycle >= prevDecCycle && in.decCycle - prevDecCycle < 16);
+    out.decDiff = in.decCycle - prevDecCycle;
+}
+
+/* BblInfos are never freed, so we bump-allocate them from large chunks. This
+ * packs them in decode order, which tends to match execution order.
+ */
+#define BBL_ARENA_CHUNK (1ul << 20)
+static char* bblArenaCur = nullptr;
+static char* bblArenaEnd = nullptr;
+
+BblInfo* Decoder::allocBbl(uint32_t bytes) {
+    bytes = (bytes + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);  // keep DynBbl's uint64_t fields aligned
+    if (unlikely(bblArenaCur + bytes > bblArenaEnd)) {
+        size_t chunkBytes = MAX(BBL_ARENA_CHUNK, (size_t)bytes);
+        bblArenaCur = static_cast<char*>(gm_malloc(chunkBytes));  // can't use type-safe interface
+        bblArenaEnd = bblArenaCur + chunkBytes;
+    }
+    BblInfo* bblInfo = reinterpret_cast<BblInfo*>(bblArenaCur);
+    bblArenaCur += bytes;
+    return bblInfo;
 }
 
 Decoder::Instr::Instr(INS _ins) : ins(_ins), numLoads(0), numInRegs(0), numOutRegs(0), numStores(0) {
@@ -172,7 +224,7 @@ void Decoder::emitLoad(Instr& instr, uint32_t idx, DynUopVec& uops, uint32_t des
 
     if (destReg == 0) destReg = REG_LOAD_TEMP + idx;
 
-    DynUop uop;
+    DecUop uop;
     uop.clear();
     uop.rs[0] = baseReg;
     uop.rs[1] = indexReg;
@@ -198,7 +250,7 @@ void Decoder::emitStore(Instr& instr, uint32_t idx, DynUopVec& uops, uint32_t sr
     //as in Nehalem loads don't issue after all prior store addresses have been resolved.
     addrReg = REG_STORE_ADDR_TEMP + idx;
 
-    DynUop addrUop;
+    DecUop addrUop;
     addrUop.clear();
     addrUop.rs[0] = baseReg;
     addrUop.rs[1] = indexReg;
@@ -209,7 +261,7 @@ void Decoder::emitStore(Instr& instr, uint32_t idx, DynUopVec& uops, uint32_t sr
     uops.push_back(addrUop);
 
     //Emit store uop
-    DynUop uop;
+    DecUop uop;
     uop.clear();
     uop.rs[0] = addrReg;
     uop.rs[1] = srcReg;
@@ -232,7 +284,7 @@ void Decoder::emitStores(Instr& instr, DynUopVec& uops) {
 }
 
 void Decoder::emitFence(DynUopVec& uops, uint32_t lat) {
-    DynUop uop;
+    DecUop uop;
     uop.clear();
     uop.lat = lat;
     uop.portMask = PORT_4; //to the store queue
@@ -241,7 +293,7 @@ void Decoder::emitFence(DynUopVec& uops, uint32_t lat) {
 }
 
 void Decoder::emitExecUop(uint32_t rs0, uint32_t rs1, uint32_t rd0, uint32_t rd1, DynUopVec& uops, uint32_t lat, uint8_t ports, uint8_t extraSlots) {
-    DynUop uop;
+    DecUop uop;
     uop.clear();
     uop.rs[0] = rs0;
     uop.rs[1] = rs1;
@@ -1234,6 +1286,68 @@ bool Decoder::decodeInstr(INS ins, DynUopVec& uops) {
     return inaccurate;
 }
 
+/* Uop templates. decodeInstr's output only depends on the instruction's
+ * encoding (we're always in 64-bit mode), so we memoize it by the raw bytes.
+ * A repeated encoding (register moves, stack ops, compares, loads with the
+ * same base and displacement, ...) then decodes with one lookup and a copy,
+ * without the PIN operand queries that dominate decodeInstr. Like bbl_map,
+ * this is only touched while decoding BBLs, which PIN serializes.
+ *
+ * The key is taken from the bytes PIN decoded, not from application memory,
+ * which self-modifying or JIT code may have rewritten since. Code with many
+ * distinct encodings (e.g., displacements and immediates) would grow the
+ * table without bound, so it is dropped once it reaches MAX_UOP_TEMPLATES.
+ */
+struct InsEncoding {
+    uint64_t w[2];  // up to 15 instruction bytes, zero-padded; the last byte holds the length
+
+    bool operator==(const InsEncoding& other) const {
+        return w[0] == other.w[0] && w[1] == other.w[1];
+    }
+};
+
+struct InsEncodingHash {
+    size_t operator()(const InsEncoding& e) const {
+        uint64_t h = (e.w[0] ^ (e.w[1] * 0x9E3779B97F4A7C15ul)) * 0xC2B2AE3D27D4EB4Ful;
+        return h ^ (h >> 32);
+    }
+};
+
+struct UopTemplate {
+    DynUopVec uops;
+    bool inaccurate;
+};
+
+#define MAX_UOP_TEMPLATES (1 << 16)
+
+static std::unordered_map<InsEncoding, UopTemplate, InsEncodingHash> uopTemplates;
+
+bool Decoder::decodeInstrCached(INS ins, DynUopVec& uops) {
+    const xed_decoded_inst_t* xedd = INS_XedDec(ins);
+    uint32_t size = xed_decoded_inst_get_length(xedd);
+    InsEncoding enc = {{0, 0}};
+    uint8_t* encBytes = reinterpret_cast<uint8_t*>(enc.w);
+    if (size >= sizeof(InsEncoding)) {
+        return decodeInstr(ins, uops);  // should not happen, x86 instrs are <= 15 bytes
+    }
+    for (uint32_t i = 0; i < size; i++) encBytes[i] = xed_decoded_inst_get_byte(xedd, i);
+    encBytes[sizeof(InsEncoding) - 1] = size;
+
+    auto it = uopTemplates.find(enc);
+    if (it != uopTemplates.end()) {
+        uops.insert(uops.end(), it->second.uops.begin(), it->second.uops.end());
+        return it->second.inaccurate;
+    }
+
+    uint32_t initialUops = uops.size();
+    bool inaccurate = decodeInstr(ins, uops);
+    if (uopTemplates.size() >= MAX_UOP_TEMPLATES) uopTemplates.clear();
+    UopTemplate& t = uopTemplates[enc];
+    t.uops.assign(uops.begin() + initialUops, uops.end());
+    t.inaccurate = inaccurate;
+    return inaccurate;
+}
+
 // See Agner Fog's uarch doc, macro-op fusion for Core 2 / Nehalem
 bool Decoder::canFuse(INS ins) {
     xed_iclass_enum_t opcode = (xed_iclass_enum_t) INS_Opcode(ins);
@@ -1295,6 +1409,11 @@ bool Decoder::decodeFusedInstrs(INS ins, DynUopVec& uops) {
     return false; //accurate
 }
 
+bool Decoder::isInferableBranch(INS ins) {
+    return INS_Category(ins) == XED_CATEGORY_COND_BR && !INS_IsXend(ins) && INS_IsDirectBranch(ins) &&
+        !INS_Valid(INS_Next(ins)) && INS_DirectBranchOrCallTargetAddress(ins) != INS_NextAddress(ins);
+}
+
 BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
     uint64_t bbl_addr = BBL_Address(bbl);
     uint32_t instrs = BBL_NumIns(bbl);
@@ -1308,6 +1427,7 @@ BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
         return bi->second;
     }
 
+    HOST_PROF_SCOPE(HP_DECODE);
     if (oooDecoding) {
         //Decode BBL
         uint32_t approxInstrs = 0;
@@ -1340,7 +1460,7 @@ BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
 
                 curIns+=2;
             } else {
-                inaccurate = Decoder::decodeInstr(ins, uopVec);
+                inaccurate = Decoder::decodeInstrCached(ins, uopVec);
 
                 instrAddr.push_back(INS_Address(ins));
                 instrBytes.push_back(INS_Size(ins));
@@ -1436,23 +1556,34 @@ BblInfo* Decoder::decodeBbl(BBL bbl, bool oooDecoding) {
 
         //Allocate
         uint32_t objBytes = offsetof(BblInfo, oooBbl) + DynBbl::bytes(uopVec.size());
-        bblInfo = static_cast<BblInfo*>(gm_malloc(objBytes));  // can't use type-safe interface
+        bblInfo = allocBbl(objBytes);
         //Initialize ooo part
         DynBbl& dynBbl = bblInfo->oooBbl[0];
         dynBbl.addr = BBL_Address(bbl);
         dynBbl.uops = uopVec.size();
         dynBbl.approxInstrs = approxInstrs;
+        uint32_t prevDecCycle = 0;
         for (uint32_t i = 0; i < dynBbl.uops; i++){
-            dynBbl.uop[i] = uopVec[i];
+            packUop(uopVec[i], prevDecCycle, dynBbl.uop[i]);
+            prevDecCycle = uopVec[i].decCycle;
         }
     } else {
-        bblInfo = static_cast<BblInfo*>(gm_malloc(offsetof(BblInfo, oooBbl)));
+        bblInfo = allocBbl(offsetof(BblInfo, oooBbl));
     }
 
     //Initialize generic part
     bblInfo->instrs = instrs;
     bblInfo->bytes = bytes;
 
+    INS tail = BBL_InsTail(bbl);
+    if (isInferableBranch(tail)) {
+        bblInfo->brPc = INS_Address(tail);
+        bblInfo->brTakenNpc = INS_DirectBranchOrCallTargetAddress(tail);
+        bblInfo->brNotTakenNpc = INS_NextAddress(tail);
+    } else {
+        bblInfo->brPc = 0;
+    }
+
     futex_lock(&bblIdxLock);
     bblInfo->bblIdx = bblIdx++;
     futex_unlock(&bblIdxLock);
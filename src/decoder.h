@@ -39,7 +39,8 @@
  */
 enum UopType : uint8_t {UOP_GENERAL, UOP_LOAD, UOP_STORE, UOP_STORE_ADDR, UOP_FENCE};
 
-struct DynUop {
+// Uop as produced by the decoder, with PIN register numbers and absolute decode cycles
+struct DecUop {
     uint16_t rs[MAX_UOP_SRC_REGS];
     uint16_t rd[MAX_UOP_DST_REGS];
     uint16_t lat;
@@ -50,7 +51,24 @@ struct DynUop {
     uint8_t pad; //pad to 4-byte multiple
 
     void clear();
-};  // 16 bytes. TODO(dsm): check performance with wider operands
+};  // 16 bytes
+
+/* Registers are renamed to a dense 8-bit space when BBLs are finalized (reg 0
+ * is still the invalid reg), so the cores' register scoreboards only need
+ * MAX_UOP_REGS entries.
+ */
+#define MAX_UOP_REGS 256
+
+// Uop as stored in DynBbls and streamed by the cores on every executed BBL
+struct DynUop {
+    uint8_t rs[MAX_UOP_SRC_REGS];
+    uint8_t rd[MAX_UOP_DST_REGS];
+    uint8_t lat;
+    uint8_t extraSlots; //FU exec slots
+    uint8_t portMask;
+    uint8_t type : 4;  // UopType
+    uint8_t decDiff : 4;  // decode cycles since the previous uop in the BBL (the 4-1-1-1 decoder model keeps this <= 3)
+};  // 8 bytes, 8 per cache line
 
 struct DynBbl {
     uint64_t addr;
@@ -89,7 +107,7 @@ struct BblInfo;  // defined in core.h
 
 #define MAX_REGISTERS (REG_EXEC_TEMP + 64)
 
-typedef std::vector<DynUop> DynUopVec;
+typedef std::vector<DecUop> DynUopVec;
 
 //Nehalem-style decoder. Fully static for now
 class Decoder {
@@ -120,10 +138,17 @@ class Decoder {
         //If oooDecoding is true, produces a DynBbl with DynUops that can be used in OOO cores
         static BblInfo* decodeBbl(BBL bbl, bool oooDecoding);
 
+        //True for conditional branches that end their BBL and have distinct direct targets,
+        //so the next BBL executed tells whether they were taken and no callback is needed
+        static bool isInferableBranch(INS ins);
+
     private:
         //Return true if inaccurate decoding, false if accurate
         static bool decodeInstr(INS ins, DynUopVec& uops);
 
+        //Same, but reuses the uops of previously decoded instructions with the same encoding
+        static bool decodeInstrCached(INS ins, DynUopVec& uops);
+
         /* Every emit function can produce 0 or more uops; it returns the number of uops. These are basic templates to make our life easier */
 
         //By default, these emit to temporary registers that depend on the index; this can be overriden, e.g. for moves
@@ -173,6 +198,11 @@ class Decoder {
         /* Macro-op (ins) fusion */
         static bool canFuse(INS ins);
         static bool decodeFusedInstrs(INS ins, DynUopVec& uops);
+
+        /* Finalization: dense register renaming, uop packing and BBL storage */
+        static uint8_t mapReg(uint32_t reg);
+        static void packUop(const DecUop& in, uint32_t prevDecCycle, DynUop& out);
+        static BblInfo* allocBbl(uint32_t bytes);
 };
 
 #endif  // DECODER_H_
@@ -0,0 +1,236 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <string>
+#include "delta_stats.h"
+#include "galloc.h"
+#include "log.h"
+#include "stats.h"
+#include "zsim.h"
+
+/** Implements the delta-compressed backend (see delta_stats.h for the format).
+ * Buffers up to recordsPerBlock records, which are written as one block whose
+ * first record is a keyframe and the rest are zigzag varint deltas, column by
+ * column. Most counters change little or not at all between periodic dumps, so
+ * a block takes a few bytes per column instead of 8 bytes per column per record.
+ * Periodic dumps are usually unbuffered, so the last block stays open: each
+ * unbuffered dump rewrites it in place with the new record, and the file is
+ * always readable. Once the block is full, the next dump starts a new one.
+ * Like the HDF5 backend, we reopen the file on every write, since dump may be
+ * called from multiple processes.
+ */
+class DeltaBackendImpl : public GlobAlloc {
+    private:
+        const char* filename;
+        AggregateStat* rootStat;
+        bool skipVectors;
+        bool sumRegularAggregates;
+
+        uint32_t numColumns;
+        uint32_t recordsPerBlock;
+        uint64_t* dataBuf; //buffered records, row-major
+        uint64_t* curPtr; //points to next element to write in dump
+        uint32_t bufferedRecords; //records in the open block, <= recordsPerBlock
+        uint64_t blockFirstRecord; //index of the open block's first record
+        uint64_t blockOffset; //file offset of the open block
+
+        g_vector<uint8_t> encBuf; //block payload
+
+        // Always have a single function to determine when to skip a stat to avoid inconsistencies in the code
+        bool skipStat(Stat* s) {
+            return skipVectors && dynamic_cast<VectorStat*>(s);
+        }
+
+        // Dump the stats, inorder walk. Must produce the columns in the same order as nameWalk()
+        void dumpWalk(Stat* s) {
+            if (skipStat(s)) return;
+            if (AggregateStat* as = dynamic_cast<AggregateStat*>(s)) {
+                if (as->isRegular() && sumRegularAggregates) {
+                    //Dump first record
+                    uint64_t* startPtr = curPtr;
+                    dumpWalk(as->get(0));
+                    uint64_t* tmpPtr = curPtr;
+                    uint32_t sz = tmpPtr - startPtr;
+                    //Dump others below, and add them up
+                    for (uint32_t i = 1; i < as->size(); i++) {
+                        dumpWalk(as->get(i));
+                        //Add record with previous ones
+                        assert(curPtr == tmpPtr + sz);
+                        for (uint32_t j = 0; j < sz; j++) startPtr[j] += tmpPtr[j];
+                        //Rewind
+                        curPtr = tmpPtr;
+                    }
+                } else {
+                    for (uint32_t i = 0; i < as->size(); i++) {
+                        dumpWalk(as->get(i));
+                    }
+                }
+            } else if (ScalarStat* ss = dynamic_cast<ScalarStat*>(s)) {
+                *(curPtr++) = ss->get();
+            } else if (VectorStat* vs = dynamic_cast<VectorStat*>(s)) {
+                for (uint32_t i = 0; i < vs->size(); i++) {
+                    *(curPtr++) = vs->count(i);
+                }
+            } else {
+                panic("Unrecognized stat type");
+            }
+        }
+
+        /* Appends the '\n'-terminated column names under s, where path is s's own name.
+         * Irregular aggregates add their children's names, regular aggregates their
+         * indices (or nothing, if summed), and vectors their element indices; this
+         * mirrors how the HDF5 backend nests compound and array types.
+         */
+        void nameWalk(Stat* s, const std::string& path, std::string& names, uint32_t& cols) {
+            if (skipStat(s)) return;
+            if (AggregateStat* as = dynamic_cast<AggregateStat*>(s)) {
+                if (as->isRegular() && sumRegularAggregates) {
+                    nameWalk(as->get(0), path, names, cols);
+                } else if (as->isRegular()) {
+                    for (uint32_t i = 0; i < as->size(); i++) {
+                        nameWalk(as->get(i), path + "/" + std::to_string(i), names, cols);
+                    }
+                } else {
+                    for (uint32_t i = 0; i < as->size(); i++) {
+                        nameWalk(as->get(i), path + "/" + as->get(i)->name(), names, cols);
+                    }
+                }
+            } else if (dynamic_cast<ScalarStat*>(s)) {
+                names += path + "\n";
+                cols++;
+            } else if (VectorStat* vs = dynamic_cast<VectorStat*>(s)) {
+                for (uint32_t i = 0; i < vs->size(); i++) {
+                    names += path + "/" + std::to_string(i) + "\n";
+                    cols++;
+                }
+            } else {
+                panic("Unrecognized stat type");
+            }
+        }
+
+        void encodeColumn(uint32_t c) {
+            const uint64_t* col = dataBuf + c;
+            uint64_t base = col[0];
+            dstatsPutVarint(encBuf, base);
+            bool constant = true;
+            bool strided = true;
+            uint64_t stride = (bufferedRecords > 1)? col[numColumns] - base : 0;
+            for (uint32_t r = 1; r < bufferedRecords; r++) {
+                uint64_t delta = col[r*numColumns] - col[(r-1)*numColumns];
+                constant &= (delta == 0);
+                strided &= (delta == stride);
+            }
+            if (constant) {
+                dstatsPutVarint(encBuf, DSTATS_CONST);
+            } else if (strided) {
+                dstatsPutVarint(encBuf, DSTATS_STRIDE);
+                dstatsPutVarint(encBuf, dstatsZigzag(stride));
+            } else {
+                dstatsPutVarint(encBuf, DSTATS_DELTAS);
+                for (uint32_t r = 1; r < bufferedRecords; r++) {
+                    dstatsPutVarint(encBuf, dstatsZigzag(col[r*numColumns] - col[(r-1)*numColumns]));
+                }
+            }
+        }
+
+        // (Re)writes the open block, and closes it if it is full
+        void writeBlock() {
+            encBuf.clear();
+            for (uint32_t c = 0; c < numColumns; c++) encodeColumn(c);
+
+            DeltaStatsBlockHeader hdr;
+            hdr.magic = DSTATS_BLOCK_MAGIC;
+            hdr.numRecords = bufferedRecords;
+            hdr.firstRecord = blockFirstRecord;
+            hdr.payloadBytes = encBuf.size();
+
+            //Blocks only grow as records are added, so rewriting the open block never leaves stale bytes behind
+            std::fstream out(filename, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+            out.seekp(blockOffset);
+            out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+            out.write(reinterpret_cast<const char*>(encBuf.data()), encBuf.size());
+            if (!out.good()) warn("Delta stats backend: write to %s failed", filename);
+
+            if (bufferedRecords == recordsPerBlock) {
+                blockFirstRecord += bufferedRecords;
+                blockOffset += sizeof(hdr) + encBuf.size();
+                bufferedRecords = 0;
+                curPtr = dataBuf;
+            }
+        }
+
+    public:
+        DeltaBackendImpl(const char* _filename, AggregateStat* _rootStat, uint32_t _recordsPerBlock, bool _skipVectors, bool _sumRegularAggregates) :
+            filename(_filename), rootStat(_rootStat), skipVectors(_skipVectors), sumRegularAggregates(_sumRegularAggregates),
+            recordsPerBlock(_recordsPerBlock), bufferedRecords(0), blockFirstRecord(0)
+        {
+            if (!recordsPerBlock) panic("Delta stats backend: records per block must be > 0");
+            info("Delta stats backend: Opening %s", filename);
+
+            //Local, only used at initialization
+            std::string names;
+            numColumns = 0;
+            nameWalk(rootStat, rootStat->name(), names, numColumns);
+
+            std::ofstream out(filename, std::ios_base::out | std::ios_base::trunc | std::ios_base::binary);
+            uint32_t namesBytes = names.size();
+            out.write(DSTATS_FILE_MAGIC, 8);
+            out.write(reinterpret_cast<const char*>(&numColumns), sizeof(numColumns));
+            out.write(reinterpret_cast<const char*>(&namesBytes), sizeof(namesBytes));
+            out.write(names.data(), namesBytes);
+            if (!out.good()) panic("Delta stats backend: could not write %s", filename);
+            blockOffset = out.tellp();
+
+            size_t bufSize = ((size_t)recordsPerBlock)*numColumns*sizeof(uint64_t);
+            if (sumRegularAggregates) bufSize += numColumns*sizeof(uint64_t); //dumpWalk() bleeds into the buffer a bit when dumping a regular aggregate
+            dataBuf = static_cast<uint64_t*>(gm_malloc(bufSize));
+            curPtr = dataBuf;
+            //Worst case per column: keyframe and mode, plus a 10-byte varint per delta
+            encBuf.reserve(((size_t)numColumns)*(11 + 10*(recordsPerBlock - 1)));
+
+            info("Delta stats backend: %d columns, keyframe every %d records", numColumns, recordsPerBlock);
+        }
+
+        ~DeltaBackendImpl() {}
+
+        void dump(bool buffered) {
+            dumpWalk(rootStat);
+            bufferedRecords++;
+            assert_msg(dataBuf + ((size_t)bufferedRecords)*numColumns == curPtr, "Delta stats (%s): %d records of %d columns, but %ld values dumped",
+                    filename, bufferedRecords, numColumns, curPtr - dataBuf);
+
+            if (bufferedRecords == recordsPerBlock || !buffered) writeBlock();
+        }
+};
+
+
+DeltaBackend::DeltaBackend(const char* filename, AggregateStat* rootStat, uint32_t recordsPerBlock, bool skipVectors, bool sumRegularAggregates) {
+    backend = new DeltaBackendImpl(filename, rootStat, recordsPerBlock, skipVectors, sumRegularAggregates);
+}
+
+void DeltaBackend::dump(bool buffered) {
+    backend->dump(buffered);
+}
@@ -0,0 +1,238 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DELTA_STATS_H_
+#define DELTA_STATS_H_
+
+/* On-disk format of the delta-compressed periodic stats backend
+ * (DeltaBackend, sim.periodicStatsFormat = "delta"), and a small reader for
+ * it. This header only depends on the standard library, so offline tools
+ * can include it without the rest of zsim.
+ *
+ * Every stat is flattened into a uint64_t column, named by its path in the
+ * stats tree (e.g., root/l1d/0/hGETS; vector elements get a trailing index).
+ * All integers are little-endian.
+ *
+ *   File header:  "ZDSTATS1", u32 numColumns, u32 namesBytes,
+ *                 namesBytes of '\n'-terminated column names
+ *   Block:        u32 DSTATS_BLOCK_MAGIC, u32 numRecords, u64 firstRecord,
+ *                 u32 payloadBytes, payload
+ *
+ * The payload is column-major. Each column is a varint keyframe (the
+ * absolute value in the block's first record), then a varint mode:
+ *   DSTATS_CONST:  the column does not change within the block
+ *   DSTATS_STRIDE: one zigzag varint, the delta between every pair of records
+ *   DSTATS_DELTAS: numRecords-1 zigzag varints, one per record
+ * Blocks are self-contained, so any record can be decoded by reading only
+ * its block; block headers carry the payload size, so the reader builds its
+ * index by skipping from header to header.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define DSTATS_FILE_MAGIC "ZDSTATS1"
+#define DSTATS_BLOCK_MAGIC 0x4b42445aU  // "ZDBK"
+
+enum DeltaStatsMode {DSTATS_CONST = 0, DSTATS_STRIDE = 1, DSTATS_DELTAS = 2};
+
+struct DeltaStatsBlockHeader {
+    uint32_t magic;
+    uint32_t numRecords;
+    uint64_t firstRecord;
+    uint32_t payloadBytes;
+} __attribute__((packed));
+
+/* Varint (LEB128) and zigzag coding */
+
+template <typename V>  // any container of uint8_t with push_back
+static inline void dstatsPutVarint(V& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// Returns nullptr on a truncated or overlong varint
+static inline const uint8_t* dstatsGetVarint(const uint8_t* p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (uint32_t shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        v |= ((uint64_t)(b & 0x7f)) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return nullptr;
+}
+
+static inline uint64_t dstatsZigzag(uint64_t delta) {
+    return (delta << 1) ^ (uint64_t)(((int64_t)delta) >> 63);
+}
+
+static inline uint64_t dstatsUnzigzag(uint64_t z) {
+    return (z >> 1) ^ (0 - (z & 1));
+}
+
+/* Reads a delta stats file. Records are returned row-major, numColumns()
+ * values per record, with either the cumulative values the simulator dumped
+ * or per-record increments (the first record's increment is its value).
+ */
+class DeltaStatsReader {
+    private:
+        struct Block {
+            uint64_t firstRecord;
+            uint32_t numRecords;
+            std::streamoff payloadOffset;
+            uint32_t payloadBytes;
+        };
+
+        std::ifstream in;
+        std::vector<std::string> names;
+        std::vector<Block> blocks;
+        uint64_t records;
+        std::string error;
+
+        bool fail(const std::string& msg) {
+            if (error.empty()) error = msg;
+            return false;
+        }
+
+        bool decodeBlock(const Block& b, uint64_t* dst) {  // dst is numRecords x numColumns
+            std::vector<uint8_t> payload(b.payloadBytes);
+            in.clear();
+            in.seekg(b.payloadOffset);
+            if (!in.read(reinterpret_cast<char*>(payload.data()), b.payloadBytes)) return fail("truncated block");
+            const uint8_t* p = payload.data();
+            const uint8_t* end = p + payload.size();
+            uint32_t nc = names.size();
+            for (uint32_t c = 0; c < nc; c++) {
+                uint64_t v, mode, z;
+                if (!(p = dstatsGetVarint(p, end, v))) return fail("corrupt keyframe");
+                if (!(p = dstatsGetVarint(p, end, mode))) return fail("corrupt column mode");
+                dst[c] = v;
+                if (mode == DSTATS_CONST) {
+                    for (uint32_t r = 1; r < b.numRecords; r++) dst[r*nc + c] = v;
+                } else if (mode == DSTATS_STRIDE) {
+                    if (!(p = dstatsGetVarint(p, end, z))) return fail("corrupt stride");
+                    uint64_t d = dstatsUnzigzag(z);
+                    for (uint32_t r = 1; r < b.numRecords; r++) dst[r*nc + c] = (v += d);
+                } else if (mode == DSTATS_DELTAS) {
+                    for (uint32_t r = 1; r < b.numRecords; r++) {
+                        if (!(p = dstatsGetVarint(p, end, z))) return fail("corrupt delta");
+                        dst[r*nc + c] = (v += dstatsUnzigzag(z));
+                    }
+                } else {
+                    return fail("unknown column mode");
+                }
+            }
+            return (p == end)? true : fail("trailing bytes in block");
+        }
+
+    public:
+        explicit DeltaStatsReader(const char* filename) : in(filename, std::ios::binary), records(0) {
+            char magic[8];
+            uint32_t nc, namesBytes;
+            if (!in.read(magic, sizeof(magic)) || memcmp(magic, DSTATS_FILE_MAGIC, sizeof(magic)) != 0) {
+                fail("not a delta stats file");
+                return;
+            }
+            if (!in.read(reinterpret_cast<char*>(&nc), sizeof(nc)) || !in.read(reinterpret_cast<char*>(&namesBytes), sizeof(namesBytes))) {
+                fail("truncated header");
+                return;
+            }
+            std::string allNames(namesBytes, '\0');
+            if (!in.read(&allNames[0], namesBytes)) {
+                fail("truncated column names");
+                return;
+            }
+            size_t start = 0, nl;
+            while ((nl = allNames.find('\n', start)) != std::string::npos) {
+                names.push_back(allNames.substr(start, nl - start));
+                start = nl + 1;
+            }
+            if (names.size() != nc) {
+                fail("column count mismatch");
+                return;
+            }
+
+            // Index blocks. A partially written last block (e.g., the simulator is still running) is ignored.
+            std::streamoff pos = in.tellg();
+            in.seekg(0, std::ios::end);
+            std::streamoff fileSize = in.tellg();
+            in.seekg(pos);
+            DeltaStatsBlockHeader hdr;
+            while (in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr))) {
+                if (hdr.magic != DSTATS_BLOCK_MAGIC || hdr.firstRecord != records) {
+                    fail("corrupt block header");
+                    break;
+                }
+                Block b = {hdr.firstRecord, hdr.numRecords, in.tellg(), hdr.payloadBytes};
+                if (b.payloadOffset + (std::streamoff)b.payloadBytes > fileSize) break;
+                in.seekg(b.payloadBytes, std::ios::cur);
+                blocks.push_back(b);
+                records += hdr.numRecords;
+            }
+        }
+
+        bool ok() const { return error.empty(); }
+        const std::string& lastError() const { return error; }
+
+        uint32_t numColumns() const { return names.size(); }
+        uint64_t numRecords() const { return records; }
+        const std::vector<std::string>& columnNames() const { return names; }
+
+        // Decodes records [start, end) into out (cleared first). Only touches the blocks that overlap the range.
+        bool read(uint64_t start, uint64_t end, std::vector<uint64_t>& out, bool incremental = false) {
+            out.clear();
+            if (end > records) end = records;
+            if (start >= end) return true;
+            uint64_t nc = names.size();
+            uint64_t first = (incremental && start > 0)? start - 1 : start;  // need the previous record for its increment
+            out.resize((end - first)*nc);
+            std::vector<uint64_t> tmp;
+            for (const Block& b : blocks) {
+                uint64_t bEnd = b.firstRecord + b.numRecords;
+                if (bEnd <= first || b.firstRecord >= end) continue;
+                tmp.resize(b.numRecords*nc);
+                if (!decodeBlock(b, tmp.data())) return false;
+                uint64_t lo = std::max(first, b.firstRecord);
+                uint64_t hi = std::min(end, bEnd);
+                std::copy(tmp.begin() + (lo - b.firstRecord)*nc, tmp.begin() + (hi - b.firstRecord)*nc, out.begin() + (lo - first)*nc);
+            }
+            if (incremental) {
+                for (uint64_t r = end - first - 1; r > 0; r--) {
+                    for (uint64_t c = 0; c < nc; c++) out[r*nc + c] -= out[(r-1)*nc + c];
+                }
+                if (first != start) out.erase(out.begin(), out.begin() + nc);
+            }
+            return true;
+        }
+};
+
+#endif  // DELTA_STATS_H_
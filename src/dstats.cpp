@@ -0,0 +1,96 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* dstats: prints a delta-compressed periodic stats file (zsim.dstats) as CSV.
+ * Usage: dstats [-i] [-r start:end] file.dstats [column-substring...]
+ *   -i: print per-record increments instead of cumulative values
+ *   -r: only print records [start, end)
+ * Columns are selected if their name contains any of the given substrings.
+ */
+
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "delta_stats.h"
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-i] [-r start:end] file.dstats [column-substring...]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    bool incremental = false;
+    uint64_t start = 0, end = UINT64_MAX;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        std::string opt = argv[i];
+        if (opt == "-i") {
+            incremental = true;
+        } else if (opt == "-r" && i + 1 < argc) {
+            char* colon;
+            start = strtoull(argv[++i], &colon, 10);
+            if (*colon != ':') usage(argv[0]);
+            if (colon[1]) end = strtoull(colon + 1, nullptr, 10);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (i >= argc) usage(argv[0]);
+
+    DeltaStatsReader reader(argv[i++]);
+    if (!reader.ok() && !reader.numColumns()) {
+        fprintf(stderr, "%s\n", reader.lastError().c_str());
+        return 1;
+    }
+
+    const std::vector<std::string>& names = reader.columnNames();
+    std::vector<uint32_t> cols;
+    for (uint32_t c = 0; c < names.size(); c++) {
+        bool match = (i == argc);
+        for (int j = i; j < argc && !match; j++) match = names[c].find(argv[j]) != std::string::npos;
+        if (match) cols.push_back(c);
+    }
+
+    std::vector<uint64_t> data;
+    if (!reader.read(start, end, data, incremental)) {
+        fprintf(stderr, "%s\n", reader.lastError().c_str());
+        return 1;
+    }
+
+    std::cout << "record";
+    for (uint32_t c : cols) std::cout << "," << names[c];
+    std::cout << "\n";
+    uint64_t nc = reader.numColumns();
+    for (uint64_t r = 0; r < data.size()/nc; r++) {
+        std::cout << start + r;
+        for (uint32_t c : cols) std::cout << "," << data[r*nc + c];
+        std::cout << "\n";
+    }
+    if (!reader.ok()) fprintf(stderr, "Warning: %s\n", reader.lastError().c_str());
+    return 0;
+}
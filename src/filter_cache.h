@@ -29,6 +29,7 @@
 #include "bithacks.h"
 #include "cache.h"
 #include "galloc.h"
+#include "host_prof.h"
 #include "zsim.h"
 
 /* Extends Cache with an L0 direct-mapped cache, optimized to hell for hits
@@ -121,6 +122,25 @@ class FilterCache : public Cache {
             return respCycle;
         }
 
+        // Equivalent to n back-to-back load()s to the same line at curCycle, with a single lookup
+        inline uint64_t loadRepeated(Address vAddr, uint64_t curCycle, uint32_t n) {
+            assert(n);
+            uint64_t respCycle = load(vAddr, curCycle);
+            // The first load leaves the line in the filter array with availCycle <= respCycle,
+            // so every other load hits and returns respCycle
+            fGETSHit += n - 1;
+            fGETSCycles += (n - 1)*(respCycle - curCycle);
+            return respCycle;
+        }
+
+        /* Batched accesses: callers that know a group of accesses upfront can
+         * prefetch their filter entries before simulating them in order. This
+         * only touches host caches, not simulated state.
+         */
+        inline void prefetchFilter(Address vAddr) const {
+            __builtin_prefetch(&filterArray[(vAddr >> lineBits) & setMask]);
+        }
+
         inline uint64_t store(Address vAddr, uint64_t curCycle) {
             Address vLineAddr = vAddr >> lineBits;
             uint32_t idx = vLineAddr & setMask;
@@ -139,6 +159,7 @@ class FilterCache : public Cache {
         }
 
         uint64_t replace(Address vLineAddr, uint32_t idx, bool isLoad, uint64_t curCycle) {
+            HOST_PROF_SCOPE(HP_CACHE_MISS);
             Address pLineAddr = procMask | vLineAddr;
             MESIState dummyState = MESIState::I;
             futex_lock(&filterLock);
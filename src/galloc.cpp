@@ -24,15 +24,20 @@
  */
 
 #include "galloc.h"
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
 #include <sys/ipc.h>
+#include <sys/mman.h>
 #include <sys/shm.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "log.h"  // NOLINT must precede dlmalloc, which defines assert if undefined
 #include "g_heap/dlmalloc.h.c"
+#include "constants.h"
 #include "locks.h"
 #include "pad.h"
 
@@ -50,10 +55,54 @@
  */
 #define GM_BASE_ADDR ((const void*)0x00ABBA000000)
 
+/* Per-core arenas. Every small allocation (up to GM_SMALL_MAX bytes) is served
+ * from size-class free lists that belong to the arena of the core the caller
+ * runs on, and that only take the global mspace lock to refill or release a
+ * batch of blocks. We index by core instead of by thread because the heap is
+ * shared by all simulated processes and the harness, and not all of them have
+ * a cheap, Pin-safe notion of thread identity; threads rarely migrate, so arena
+ * locks are essentially uncontended. Blocks freed on a different core than the
+ * one that allocated them simply join the freeing core's lists.
+ */
+#define GM_ARENAS 64
+#define GM_SIZE_CLASSES 16  // 16-byte granularity
+#define GM_SMALL_MAX (16*GM_SIZE_CLASSES)
+#define GM_CLASS_BATCH 16  // blocks moved to/from the mspace at once
+#define GM_CLASS_MAX_CACHED (4*GM_CLASS_BATCH)  // per class and arena
+
+struct gm_arena {
+    lock_t lock;
+    uint32_t cached[GM_SIZE_CLASSES];
+    void* freeList[GM_SIZE_CLASSES];  // singly-linked through the first word of each block
+} ATTR_LINE_ALIGNED;
+
+/* Per-thread caches. Processes that can name their threads cheaply (the
+ * simulator, through PIN_ThreadId, see gm_set_thread_id_fn) get a small,
+ * lock-free cache per thread in front of the per-core arenas, so the common
+ * gm_malloc/gm_free touches neither sched_getcpu() nor the arena lock. These
+ * caches are process-local (the id space is per process), hold blocks of the
+ * shared heap, and move GM_THREAD_BATCH blocks at a time to/from the arena of
+ * the core the thread runs on. A cache outlives its thread and is inherited by
+ * the next thread that gets the same id.
+ */
+#define GM_THREAD_BATCH 8
+#define GM_THREAD_MAX_CACHED (2*GM_THREAD_BATCH)  // per class and thread
+
+struct gm_thread_cache {
+    uint32_t cached[GM_SIZE_CLASSES];
+    void* freeList[GM_SIZE_CLASSES];
+} ATTR_LINE_ALIGNED;
+
+static gm_thread_cache gm_tcaches[MAX_THREADS];
+static uint32_t (*gm_thread_id_fn)() = nullptr;
+
 struct gm_segment {
     volatile void* base_regp; //common data structure, accessible with glob_ptr; threads poll on gm_isready to determine when everything has been initialized
     volatile void* secondary_regp; //secondary data structure, used to exchange information between harness and initializing process
     mspace mspace_ptr;
+    gm_arena* arenas;
+    size_t segmentSize;
+    GMHugePages hugePages;
 
     PAD();
     lock_t lock;
@@ -63,24 +112,63 @@ struct gm_segment {
 static gm_segment* GM = nullptr;
 static int gm_shmid = 0;
 
-/* Heap segment size, in bytes. Can't grow for now, so choose something sensible, and within the machine's limits (see sysctl vars kernel.shmmax and kernel.shmall) */
-int gm_init(size_t segmentSize) {
-    /* Create a SysV IPC shared memory segment, attach to it, and mark the segment to
-     * auto-destroy when the number of attached processes becomes 0.
+// Transparent huge pages must be requested on each process's own mapping
+static void gm_advise(GMHugePages hugePages, size_t segmentSize) {
+    if (hugePages == GM_HP_THP && madvise(GM, segmentSize, MADV_HUGEPAGE) != 0) {
+        warn("madvise(MADV_HUGEPAGE) on the global heap failed, continuing with regular pages");
+    }
+}
+
+/* Heap segment size, in bytes. This is a reservation, not a commitment: the
+ * segment is created with SHM_NORESERVE and SysV shared memory is demand-paged,
+ * so physical memory is only allocated as the heap is touched. Thus, the size
+ * can be generous (within kernel.shmmax/shmall), and there is no need to tune
+ * it per application.
+ */
+static size_t gm_segment_bytes(size_t segmentSize, GMHugePages hugePages) {
+    if (hugePages == GM_HP_HUGETLB) {
+        // Unlike the regular-page segment, explicit huge pages come from the preallocated hugetlbfs
+        // pool (vm.nr_hugepages), so this segment is committed upfront; round to whole huge pages
+        const size_t hugePageSize = 2 << 20;
+        segmentSize = (segmentSize + hugePageSize - 1) & ~(hugePageSize - 1);
+    }
+    return segmentSize;
+}
+
+int gm_try_reserve(size_t segmentSize, GMHugePages hugePages) {
+    int shmflg = 0644 | IPC_CREAT | SHM_NORESERVE;
+    if (hugePages == GM_HP_HUGETLB) shmflg |= SHM_HUGETLB;
+    return shmget(IPC_PRIVATE, gm_segment_bytes(segmentSize, hugePages), shmflg);
+}
+
+int gm_reserve(size_t segmentSize, GMHugePages hugePages) {
+    int shmid = gm_try_reserve(segmentSize, hugePages);
+    if (shmid == -1) {
+        perror("gm_reserve failed shmget");
+        exit(1);
+    }
+    return shmid;
+}
+
+int gm_init(size_t segmentSize, GMHugePages hugePages) {
+    return gm_init_reserved(gm_reserve(segmentSize, hugePages), segmentSize, hugePages);
+}
+
+int gm_init_reserved(int shmid, size_t segmentSize, GMHugePages hugePages) {
+    /* Attach to a SysV IPC shared memory segment created by gm_reserve, and mark the
+     * segment to auto-destroy when the number of attached processes becomes 0.
      *
-     * IMPORTANT: There is a small window of vulnerability between shmget and shmctl that
+     * IMPORTANT: There is a window of vulnerability between shmget and shmctl that
      * can lead to major issues: between these calls, we have a segment of persistent
      * memory that will survive the program if it dies (e.g. someone just happens to send us
-     * a SIGKILL)
+     * a SIGKILL). gm_init keeps it small; pooled segments (see zsim_harness's server mode)
+     * live in this window until they are handed out.
      */
 
     assert(GM == nullptr);
     assert(gm_shmid == 0);
-    gm_shmid = shmget(IPC_PRIVATE, segmentSize, 0644 | IPC_CREAT /*| SHM_HUGETLB*/);
-    if (gm_shmid == -1) {
-        perror("gm_create failed shmget");
-        exit(1);
-    }
+    segmentSize = gm_segment_bytes(segmentSize, hugePages);
+    gm_shmid = shmid;
     GM = static_cast<gm_segment*>(shmat(gm_shmid, GM_BASE_ADDR, 0));
     if (GM != GM_BASE_ADDR) {
         perror("gm_create failed shmat");
@@ -98,17 +186,33 @@ int gm_init(size_t segmentSize) {
     int ret = shmctl(gm_shmid, IPC_RMID, nullptr);
     assert(!ret);
 
+    gm_advise(hugePages, segmentSize);
+
     char* alloc_start = reinterpret_cast<char*>(GM) + 1024;
     size_t alloc_size = segmentSize - 1 - 1024;
     GM->base_regp = nullptr;
+    GM->segmentSize = segmentSize;
+    GM->hugePages = hugePages;
 
     GM->mspace_ptr = create_mspace_with_base(alloc_start, alloc_size, 1 /*locked*/);
     futex_init(&GM->lock);
     assert(GM->mspace_ptr);
 
+    GM->arenas = static_cast<gm_arena*>(mspace_memalign(GM->mspace_ptr, CACHE_LINE_BYTES, GM_ARENAS*sizeof(gm_arena)));
+    assert(GM->arenas);
+    memset(GM->arenas, 0, GM_ARENAS*sizeof(gm_arena));
+    for (uint32_t i = 0; i < GM_ARENAS; i++) futex_init(&GM->arenas[i].lock);
+
     return gm_shmid;
 }
 
+void gm_release(int shmid) {
+    if (shmctl(shmid, IPC_RMID, nullptr)) {
+        perror("gm_release failed shmctl");
+        warn("Check /proc/sysvipc/shm and manually delete segment with shmid %d", shmid);
+    }
+}
+
 void gm_attach(int shmid) {
     assert(GM == nullptr);
     assert(gm_shmid == 0);
@@ -118,25 +222,156 @@ void gm_attach(int shmid) {
         warn("shmid %d \n", shmid);
         panic("gm_attach failed allocation");
     }
+    gm_advise(GM->hugePages, GM->segmentSize);
+}
+
+
+void gm_set_thread_id_fn(uint32_t (*tidFn)()) {
+    gm_thread_id_fn = tidFn;
+}
+
+void gm_drop_thread_caches() {
+    memset(gm_tcaches, 0, sizeof(gm_tcaches));
+}
+
+static inline gm_thread_cache* gm_cur_thread_cache() {
+    if (!gm_thread_id_fn) return nullptr;
+    uint32_t tid = gm_thread_id_fn();
+    return (tid < MAX_THREADS)? &gm_tcaches[tid] : nullptr;
+}
+
+static inline gm_arena* gm_cur_arena() {
+    int cpu = sched_getcpu();
+    return &GM->arenas[(cpu < 0)? 0 : (cpu % GM_ARENAS)];
+}
+
+static inline uint32_t gm_size_class(size_t size) {
+    return (size == 0)? 0 : (size - 1)/16;
+}
+
+// Pops a block of class cls, refilling the arena from the mspace if it is empty. Caller holds a->lock
+static void* gm_arena_pop(gm_arena* a, uint32_t cls) {
+    void* ptr = a->freeList[cls];
+    if (ptr) {
+        a->freeList[cls] = *static_cast<void**>(ptr);
+        a->cached[cls]--;
+    } else {
+        // Refill: grab a batch of blocks under a single global lock acquisition
+        size_t clsSize = 16*(cls + 1);
+        futex_lock(&GM->lock);
+        ptr = mspace_malloc(GM->mspace_ptr, clsSize);
+        for (uint32_t i = 1; ptr && i < GM_CLASS_BATCH; i++) {
+            void* blk = mspace_malloc(GM->mspace_ptr, clsSize);
+            if (!blk) break;
+            *static_cast<void**>(blk) = a->freeList[cls];
+            a->freeList[cls] = blk;
+            a->cached[cls]++;
+        }
+        futex_unlock(&GM->lock);
+    }
+    return ptr;
+}
+
+// Pushes a block of class cls, releasing a batch to the mspace if the arena caches too many. Caller holds a->lock
+static void gm_arena_push(gm_arena* a, uint32_t cls, void* ptr) {
+    *static_cast<void**>(ptr) = a->freeList[cls];
+    a->freeList[cls] = ptr;
+    a->cached[cls]++;
+    if (a->cached[cls] > GM_CLASS_MAX_CACHED) {
+        // Release a batch back to the mspace
+        futex_lock(&GM->lock);
+        for (uint32_t i = 0; i < GM_CLASS_BATCH; i++) {
+            void* blk = a->freeList[cls];
+            a->freeList[cls] = *static_cast<void**>(blk);
+            mspace_free(GM->mspace_ptr, blk);
+        }
+        futex_unlock(&GM->lock);
+        a->cached[cls] -= GM_CLASS_BATCH;
+    }
+}
+
+static void* gm_small_alloc(size_t size) {
+    uint32_t cls = gm_size_class(size);
+    gm_thread_cache* tc = gm_cur_thread_cache();
+    void* ptr = tc? tc->freeList[cls] : nullptr;
+    if (ptr) {
+        // Fast path, no locks
+        tc->freeList[cls] = *static_cast<void**>(ptr);
+        tc->cached[cls]--;
+        return ptr;
+    }
+
+    gm_arena* a = gm_cur_arena();
+    futex_lock(&a->lock);
+    ptr = gm_arena_pop(a, cls);
+    for (uint32_t i = 1; tc && ptr && i < GM_THREAD_BATCH; i++) {
+        void* blk = gm_arena_pop(a, cls);
+        if (!blk) break;
+        *static_cast<void**>(blk) = tc->freeList[cls];
+        tc->freeList[cls] = blk;
+        tc->cached[cls]++;
+    }
+    futex_unlock(&a->lock);
+    return ptr;
 }
 
+// Returns false if the block is too large to be cached
+static bool gm_small_free(void* ptr) {
+    // Any block can serve the largest class that fits in its usable size, no matter how it was allocated
+    uint32_t cls = mspace_usable_size(ptr)/16 - 1;
+    if (cls >= GM_SIZE_CLASSES) return false;
+
+    gm_thread_cache* tc = gm_cur_thread_cache();
+    if (tc) {
+        *static_cast<void**>(ptr) = tc->freeList[cls];
+        tc->freeList[cls] = ptr;
+        if (++tc->cached[cls] <= GM_THREAD_MAX_CACHED) return true;  // fast path, no locks
+    }
+
+    gm_arena* a = gm_cur_arena();
+    futex_lock(&a->lock);
+    if (tc) {
+        // Spill a batch to the arena
+        for (uint32_t i = 0; i < GM_THREAD_BATCH; i++) {
+            void* blk = tc->freeList[cls];
+            tc->freeList[cls] = *static_cast<void**>(blk);
+            gm_arena_push(a, cls, blk);
+        }
+        tc->cached[cls] -= GM_THREAD_BATCH;
+    } else {
+        gm_arena_push(a, cls, ptr);
+    }
+    futex_unlock(&a->lock);
+    return true;
+}
 
 void* gm_malloc(size_t size) {
     assert(GM);
     assert(GM->mspace_ptr);
-    futex_lock(&GM->lock);
-    void* ptr = mspace_malloc(GM->mspace_ptr, size);
-    futex_unlock(&GM->lock);
-    if (!ptr) panic("gm_malloc(): Out of global heap memory, use a larger GM segment");
+    void* ptr;
+    if (size <= GM_SMALL_MAX) {
+        ptr = gm_small_alloc(size);
+    } else {
+        futex_lock(&GM->lock);
+        ptr = mspace_malloc(GM->mspace_ptr, size);
+        futex_unlock(&GM->lock);
+    }
+    if (!ptr) panic("gm_malloc(): Out of global heap memory, use a larger GM segment (sim.gmMBytes)");
     return ptr;
 }
 
 void* __gm_calloc(size_t num, size_t size) {
     assert(GM);
     assert(GM->mspace_ptr);
-    futex_lock(&GM->lock);
-    void* ptr = mspace_calloc(GM->mspace_ptr, num, size);
-    futex_unlock(&GM->lock);
+    void* ptr;
+    if (size && num <= GM_SMALL_MAX/size) {
+        ptr = gm_small_alloc(num*size);
+        if (ptr) memset(ptr, 0, num*size);
+    } else {
+        futex_lock(&GM->lock);
+        ptr = mspace_calloc(GM->mspace_ptr, num, size);
+        futex_unlock(&GM->lock);
+    }
     if (!ptr) panic("gm_calloc(): Out of global heap memory, use a larger GM segment");
     return ptr;
 }
@@ -155,6 +390,7 @@ void* __gm_memalign(size_t blocksize, size_t bytes) {
 void gm_free(void* ptr) {
     assert(GM);
     assert(GM->mspace_ptr);
+    if (!ptr || gm_small_free(ptr)) return;
     futex_lock(&GM->lock);
     mspace_free(GM->mspace_ptr, ptr);
     futex_unlock(&GM->lock);
@@ -195,9 +431,34 @@ void* gm_get_secondary_ptr() {
 
 void gm_stats() {
     assert(GM);
+    size_t cachedBytes = 0;
+    for (uint32_t i = 0; i < GM_ARENAS; i++) {
+        for (uint32_t c = 0; c < GM_SIZE_CLASSES; c++) cachedBytes += GM->arenas[i].cached[c]*16*(c + 1);
+    }
+    size_t threadBytes = 0;
+    for (uint32_t i = 0; i < MAX_THREADS; i++) {
+        for (uint32_t c = 0; c < GM_SIZE_CLASSES; c++) threadBytes += gm_tcaches[i].cached[c]*16*(c + 1);
+    }
+    info("Global heap: %ld bytes cached in per-core arenas, %ld in this process's thread caches", cachedBytes, threadBytes);
     mspace_malloc_stats(GM->mspace_ptr);
 }
 
+size_t gm_footprint() {
+    assert(GM);
+    return mspace_footprint(GM->mspace_ptr);  // a single field read, no need to lock
+}
+
+size_t gm_segment_size() {
+    assert(GM);
+    return GM->segmentSize;
+}
+
+int gm_mbind(int mode, const unsigned long* nodeMask, unsigned long maxNode, unsigned flags) {
+    assert(GM);
+    //The policy is kept by the shared memory object, so it applies to every process that attaches to the segment
+    return syscall(SYS_mbind, GM, GM->segmentSize, mode, nodeMask, maxNode, flags);
+}
+
 bool gm_isready() {
     assert(GM);
     return (GM->base_regp != nullptr);
@@ -26,13 +26,40 @@
 #ifndef GALLOC_H_
 #define GALLOC_H_
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-int gm_init(size_t segmentSize);
+enum GMHugePages {
+    GM_HP_NONE,     // regular 4KB pages
+    GM_HP_THP,      // transparent huge pages (needs shmem_enabled=advise or always)
+    GM_HP_HUGETLB,  // explicit huge pages from the hugetlbfs pool
+};
+
+// Default sim.gmMBytes (16GB). Only a reservation, see gm_segment_bytes
+#define GM_DEFAULT_MBYTES (1 << 14)
+
+int gm_init(size_t segmentSize, GMHugePages hugePages = GM_HP_NONE);
+
+// Split version of gm_init: gm_reserve only creates the (unattached, persistent)
+// segment; gm_init_reserved attaches and initializes it, and gm_release destroys
+// a reserved segment that will not be used. gm_reserve exits on failure;
+// gm_try_reserve returns -1 instead, for long-lived callers (the job server)
+int gm_reserve(size_t segmentSize, GMHugePages hugePages = GM_HP_NONE);
+int gm_try_reserve(size_t segmentSize, GMHugePages hugePages = GM_HP_NONE);
+int gm_init_reserved(int shmid, size_t segmentSize, GMHugePages hugePages = GM_HP_NONE);
+void gm_release(int shmid);
 
 void gm_attach(int shmid);
 
+// Enables lock-free per-thread caches for small allocations in this process.
+// tidFn must return a stable id for the calling thread (e.g., PIN_ThreadId);
+// threads with ids >= MAX_THREADS go straight to the per-core arenas
+void gm_set_thread_id_fn(uint32_t (*tidFn)());
+// Forgets this process's thread caches without freeing their blocks. Call in
+// the child after a fork(), as the parent still owns (and reuses) them
+void gm_drop_thread_caches();
+
 // C-style interface
 void* gm_malloc(size_t size);
 void* __gm_calloc(size_t num, size_t size);  //deprecated, only used internally
@@ -61,6 +88,14 @@ void* gm_get_secondary_ptr();
 
 void gm_stats();
 
+// Bytes of the segment the heap has touched so far, and the segment's reserved size. Lock-free, for monitoring
+size_t gm_footprint();
+size_t gm_segment_size();
+
+// Sets the NUMA memory policy of the whole segment, see mbind(2). Only pages
+// faulted in afterwards follow it, unless flags has MPOL_MF_MOVE. Returns 0 on success
+int gm_mbind(int mode, const unsigned long* nodeMask, unsigned long maxNode, unsigned flags);
+
 bool gm_isready();
 void gm_detach();
 
@@ -0,0 +1,134 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* h3check: checks H3HashFamily's byte-table hashing against the matrix
+ * implementation it is built from, and times both.
+ * Usage: h3check [-n inputs] [-s seed]
+ * For several output widths, hash() and hashN() must match referenceHash() on
+ * random inputs of every magnitude; any mismatch exits with status 1. Then it
+ * reports ns per hash for the matrix code, hash() (through a HashFamily*, as
+ * the caches call it), and hashN().
+ */
+
+#include <chrono>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "galloc.h"
+#include "hash.h"
+
+#define H3CHECK_FUNCS 4
+
+static uint64_t rngState = 88172645463325252ul;
+static uint64_t xorshift() {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 7;
+    rngState ^= rngState << 17;
+    return rngState;
+}
+
+static volatile uint64_t sink;
+
+static double nsPerHash(std::chrono::steady_clock::time_point start, uint64_t hashes) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / hashes;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t inputs = 1000000;
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-n" && i + 1 < argc) {
+            inputs = strtoull(argv[++i], nullptr, 0);
+        } else if (opt == "-s" && i + 1 < argc) {
+            rngState = strtoull(argv[++i], nullptr, 0) | 1;
+        } else {
+            fprintf(stderr, "Usage: %s [-n inputs] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    gm_init(1 << 26);
+
+    const uint32_t widths[] = {4, 8, 12, 16, 20, 32, 48, 64};
+    std::vector<uint64_t> in(4096), out(4096);
+    for (uint32_t bits : widths) {
+        H3HashFamily* h = new H3HashFamily(H3CHECK_FUNCS, bits, 0xCAC7EAFFA1ul + bits);
+        for (uint64_t i = 0; i < inputs; i++) {
+            uint64_t val = xorshift() >> (i % 64);  // cover small values (e.g., line addresses) too
+            uint32_t id = i % H3CHECK_FUNCS;
+            if (h->hash(id, val) != h->referenceHash(id, val)) {
+                printf("MISMATCH: %d bits, function %d, input 0x%lx: table 0x%lx, matrix 0x%lx\n",
+                        bits, id, val, h->hash(id, val), h->referenceHash(id, val));
+                return 1;
+            }
+        }
+        for (uint64_t& v : in) v = xorshift();
+        h->hashN(1, &in[0], &out[0], in.size());
+        for (uint32_t i = 0; i < in.size(); i++) {
+            if (out[i] != h->referenceHash(1, in[i])) {
+                printf("MISMATCH: %d bits, hashN input 0x%lx\n", bits, in[i]);
+                return 1;
+            }
+        }
+        delete h;
+    }
+    printf("hash() and hashN() match the matrix hash on %ld inputs per width\n", inputs);
+
+    const uint32_t reps = 2000;
+    const uint64_t hashes = (uint64_t)reps*in.size();
+    for (uint64_t& v : in) v = xorshift() >> 6;
+    printf("%6s %12s %12s %12s\n", "bits", "matrix ns", "hash ns", "hashN ns");
+    for (uint32_t bits : {8u, 16u, 32u, 64u}) {
+        H3HashFamily* h3 = new H3HashFamily(H3CHECK_FUNCS, bits);
+        HashFamily* hf = h3;
+        uint64_t sum = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < reps; r++) {
+            for (uint64_t v : in) sum += h3->referenceHash(r % H3CHECK_FUNCS, v);
+        }
+        double matrixNs = nsPerHash(start, hashes);
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < reps; r++) {
+            for (uint64_t v : in) sum += hf->hash(r % H3CHECK_FUNCS, v);
+        }
+        double hashNs = nsPerHash(start, hashes);
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t r = 0; r < reps; r++) {
+            hf->hashN(r % H3CHECK_FUNCS, &in[0], &out[0], in.size());
+            sum += out[r % in.size()];
+        }
+        double hashNNs = nsPerHash(start, hashes);
+
+        sink = sum;  // keep the loops
+        printf("%6d %12.2f %12.2f %12.2f\n", bits, matrixNs, hashNs, hashNNs);
+        delete h3;
+    }
+    return 0;
+}
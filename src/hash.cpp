@@ -28,6 +28,7 @@
 #include <stdlib.h>
 #include "log.h"
 #include "mtrand.h"
+#include "pad.h"
 
 H3HashFamily::H3HashFamily(uint32_t numFunctions, uint32_t outputBits, uint64_t randSeed) : numFuncs(numFunctions) {
     MTRand rnd(randSeed);
@@ -59,13 +60,40 @@ H3HashFamily::H3HashFamily(uint32_t numFunctions, uint32_t outputBits, uint64_t
             hMatrix[ii*words + jj] = val;
         }
     }
+
+    /* H3 is linear over GF(2) (and so is the output folding): the hash of a value
+     * is the XOR of the hashes of its bytes in place. So we precompute, for every
+     * byte position and byte value, the folded hash, and hash() becomes 8 lookups
+     * and XORs (16KB of tables per function) instead of the 64-row matrix walk.
+     */
+    byteTables = gm_memalign<uint64_t>(CACHE_LINE_BYTES, numFuncs*8*256);
+    for (uint32_t ii = 0; ii < numFuncs; ii++) {
+        for (uint32_t b = 0; b < 8; b++) {
+            for (uint32_t v = 0; v < 256; v++) {
+                byteTables[(ii*8 + b)*256 + v] = matrixHash(ii, ((uint64_t)v) << (8*b));
+            }
+        }
+    }
 }
 
 H3HashFamily::~H3HashFamily() {
     gm_free(hMatrix);
+    gm_free(byteTables);
 }
 
-/* NOTE: This is fairly well hand-optimized. Go to the commit logs to see the speedup of this function. Main things:
+uint64_t H3HashFamily::hash(uint32_t id, uint64_t val) {
+    assert(id < numFuncs);
+    return tableHash(&byteTables[id*8*256], val);
+}
+
+void H3HashFamily::hashN(uint32_t id, const uint64_t* in, uint64_t* out, uint32_t n) {
+    assert(id < numFuncs);
+    const uint64_t* t = &byteTables[id*8*256];
+    for (uint32_t i = 0; i < n; i++) out[i] = tableHash(t, in[i]);
+}
+
+/* Reference implementation, now only used to fill the byte tables.
+ * NOTE: This is fairly well hand-optimized. Go to the commit logs to see the speedup of this function. Main things:
  * 1. resShift indicates how many bits of output are computed (64, 32, 16, or 8). With less than 64 bits, several rounds are folded at the end.
  * 2. The output folding does not mask, the output is expected to be masked by caller.
  * 3. The main loop is hand-unrolled and optimized for ILP.
@@ -77,7 +105,7 @@ H3HashFamily::~H3HashFamily() {
  *     res = (res << 1) | (res >> 63);
  * }
  */
-uint64_t H3HashFamily::hash(uint32_t id, uint64_t val) {
+uint64_t H3HashFamily::matrixHash(uint32_t id, uint64_t val) {
     uint64_t res = 0;
     assert(id >= 0 && id < numFuncs);
 
@@ -35,6 +35,11 @@ class HashFamily : public GlobAlloc {
         virtual ~HashFamily() {}
 
         virtual uint64_t hash(uint32_t id, uint64_t val) = 0;
+
+        // Batched version, out[i] = hash(id, in[i]); in and out may be the same array
+        virtual void hashN(uint32_t id, const uint64_t* in, uint64_t* out, uint32_t n) {
+            for (uint32_t i = 0; i < n; i++) out[i] = hash(id, in[i]);
+        }
 };
 
 class H3HashFamily : public HashFamily {
@@ -42,10 +47,23 @@ class H3HashFamily : public HashFamily {
         const uint32_t numFuncs;
         uint32_t resShift;
         uint64_t* hMatrix;
+        uint64_t* byteTables;  // per function, 8 tables of 256 entries, one per input byte
+
+        uint64_t matrixHash(uint32_t id, uint64_t val);
+
+        inline uint64_t tableHash(const uint64_t* t, uint64_t val) const {
+            return t[val & 0xff] ^ t[256 + ((val >> 8) & 0xff)] ^ t[512 + ((val >> 16) & 0xff)] ^ t[768 + ((val >> 24) & 0xff)] ^
+                t[1024 + ((val >> 32) & 0xff)] ^ t[1280 + ((val >> 40) & 0xff)] ^ t[1536 + ((val >> 48) & 0xff)] ^ t[1792 + (val >> 56)];
+        }
+
     public:
         H3HashFamily(uint32_t numFunctions, uint32_t outputBits, uint64_t randSeed = 123132127);
         virtual ~H3HashFamily();
         uint64_t hash(uint32_t id, uint64_t val);
+        void hashN(uint32_t id, const uint64_t* in, uint64_t* out, uint32_t n);
+
+        // The matrix implementation the byte tables are built from, to check them (see h3check)
+        uint64_t referenceHash(uint32_t id, uint64_t val) { return matrixHash(id, val); }
 };
 
 class SHA1HashFamily : public HashFamily {
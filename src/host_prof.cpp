@@ -0,0 +1,56 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "host_prof.h"
+
+HostProfiler* hostProf = nullptr;
+HostProfCountdown hostProfCountdowns[MAX_THREADS];
+
+HostProfiler::HostProfiler(uint32_t _samplePeriod) : samplePeriod(_samplePeriod) {
+    assert(samplePeriod > 0);
+}
+
+void HostProfiler::initProcess() {
+    // Stagger the first samples so regions and threads entered in lockstep are not always timed together
+    for (uint32_t t = 0; t < MAX_THREADS; t++) {
+        for (uint32_t r = 0; r < HP_NUM_REGIONS; r++) {
+            hostProfCountdowns[t].left[r] = 1 + (r*7919 + t*104729) % samplePeriod;
+        }
+    }
+}
+
+void HostProfiler::initStats(AggregateStat* parentStat) {
+    static const char* regionNames[] = {"bblCallback", "memCallback", "modelBbl", "cacheMiss", "bpred",
+        "decode", "barrier", "weave", "statsDump"};
+    static_assert(sizeof(regionNames)/sizeof(regionNames[0]) == HP_NUM_REGIONS, "regionNames out of sync");
+
+    AggregateStat* profStat = new AggregateStat();
+    profStat->init("hostProf", "Sampled host time of simulator hot paths (inclusive)");
+    cycles.init("cycles", "Estimated host TSC cycles per region", HP_NUM_REGIONS, regionNames);
+    samples.init("samples", "Timed entries per region", HP_NUM_REGIONS, regionNames);
+    profStat->append(&cycles);
+    profStat->append(&samples);
+    parentStat->append(profStat);
+}
@@ -0,0 +1,126 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_PROF_H_
+#define HOST_PROF_H_
+
+#include <stdint.h>
+#include "constants.h"
+#include "galloc.h"
+#include "log.h"
+#include "pad.h"
+#include "pin.H"
+#include "rdtsc.h"
+#include "stats.h"
+
+/* Sampled host-time accounting of the simulator's own hot paths.
+ *
+ * Each thread keeps a countdown per region; one in every samplePeriod entries is timed
+ * with rdtsc, and its duration is charged samplePeriod times. Regions nest
+ * (e.g., bblCallback includes modelBbl, which includes cacheMiss), so times
+ * are inclusive and do not add up. Counts live in the stats tree under
+ * hostProf, so periodic dumps give a per-slice breakdown.
+ *
+ * When sim.hostProf.enable is false, every scope costs one load and a
+ * predictable branch on the process-local hostProf pointer.
+ *
+ * Countdowns are process-local and indexed by Pin thread id, one line per
+ * thread, so the common (unsampled) path never touches shared memory. Only
+ * timed entries update the shared counters; like other zsim counters, those
+ * updates are not atomic, so counts are approximate, which is fine for a
+ * profile.
+ */
+
+enum HostProfRegion {
+    HP_BBL_CALLBACK,  // IndirectBasicBlock
+    HP_MEM_CALLBACK,  // Indirect{Pred,}{Load,Store}Single
+    HP_MODEL_BBL,     // micro-model bbl()
+    HP_CACHE_MISS,    // FilterCache::replace, i.e., the whole Cache::access chain
+    HP_BPRED,         // BranchPredictorTage::predict
+    HP_DECODE,        // Decoder::decodeBbl
+    HP_BARRIER,       // TakeBarrier (phase sync)
+    HP_WEAVE,         // ContentionSim::simulatePhase
+    HP_STATS_DUMP,    // periodic stats dumps
+    HP_NUM_REGIONS
+};
+
+// Per-thread sampling state; lives in process-local memory, not the global heap
+struct HostProfCountdown {
+    uint32_t left[HP_NUM_REGIONS];
+} ATTR_LINE_ALIGNED;
+
+extern HostProfCountdown hostProfCountdowns[MAX_THREADS];
+
+class HostProfiler : public GlobAlloc {
+    private:
+        const uint32_t samplePeriod;
+        VectorCounter cycles;
+        VectorCounter samples;
+
+    public:
+        explicit HostProfiler(uint32_t _samplePeriod);
+
+        void initStats(AggregateStat* parentStat);
+
+        // Seeds this process's countdowns; call once per process before any thread samples
+        void initProcess();
+
+        // Returns whether this entry to region r should be timed
+        inline bool sample(uint32_t r) {
+            THREADID tid = PIN_ThreadId();
+            assert(tid < MAX_THREADS);
+            uint32_t& left = hostProfCountdowns[tid].left[r];
+            if (likely(--left)) return false;
+            left = samplePeriod;
+            return true;
+        }
+
+        inline void record(uint32_t r, uint64_t tscCycles) {
+            cycles.inc(r, tscCycles*samplePeriod);
+            samples.inc(r);
+        }
+};
+
+// Process-local copy of zinfo->hostProf, nullptr if disabled
+extern HostProfiler* hostProf;
+
+class HostProfScope {
+    private:
+        uint64_t start;
+        const uint32_t region;
+
+    public:
+        explicit inline HostProfScope(uint32_t r) : start(0), region(r) {
+            if (unlikely(hostProf != nullptr) && hostProf->sample(r)) start = rdtsc();
+        }
+
+        inline ~HostProfScope() {
+            if (unlikely(start != 0)) hostProf->record(region, rdtsc() - start);
+        }
+};
+
+#define HOST_PROF_SCOPE(r) HostProfScope hostProfScope(r)
+
+#endif  // HOST_PROF_H_
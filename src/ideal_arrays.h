@@ -27,8 +27,8 @@
 #define IDEAL_ARRAYS_H_
 
 #include "cache_arrays.h"
-#include "g_std/g_unordered_map.h"
 #include "intrusive_list.h"
+#include "line_index.h"
 #include "part_repl_policies.h"
 #include "repl_policies.h"
 
@@ -62,14 +62,14 @@ class IdealLRUArray : public CacheArray {
 
         Entry* array;
         InList<Entry> lruList;
-        g_unordered_map<Address, uint32_t> lineMap; //address->lineId; if too slow, try an AATree, which does not alloc dynamically
+        LineIndex lineMap; //address->lineId
 
         uint32_t numLines;
         ProxyReplPolicy* rp;
         CC* cc;
 
     public:
-        explicit IdealLRUArray(uint32_t _numLines) : numLines(_numLines), cc(nullptr) {
+        explicit IdealLRUArray(uint32_t _numLines) : lineMap(_numLines), numLines(_numLines), cc(nullptr) {
             array = gm_calloc<Entry>(numLines);
             for (uint32_t i = 0; i < numLines; i++) {
                 Entry* e = new (&array[i]) Entry(i);
@@ -79,10 +79,9 @@ class IdealLRUArray : public CacheArray {
         }
 
         int32_t lookup(const Address lineAddr, const MemReq* req, bool updateReplacement) {
-            g_unordered_map<Address, uint32_t>::iterator it = lineMap.find(lineAddr);
-            if (it == lineMap.end()) return -1;
+            int32_t lineId = lineMap.find(lineAddr);
+            if (lineId == -1) return -1;
 
-            uint32_t lineId = it->second;
             if (updateReplacement) {
                 lruList.remove(&array[lineId]);
                 lruList.push_front(&array[lineId]);
@@ -100,10 +99,10 @@ class IdealLRUArray : public CacheArray {
             Entry* e = &array[lineId];
 
             //Update addr mapping for lineId
-            lineMap.erase(e->lineAddr);
-            assert((lineMap.find(lineAddr) == lineMap.end()));
+            lineMap.erase(e->lineAddr, lineId);
+            assert(lineMap.find(lineAddr) == -1);
             e->lineAddr = lineAddr;
-            lineMap[lineAddr] = lineId;
+            lineMap.insert(lineAddr, lineId);
 
             //Update repl
             lruList.remove(e);
@@ -241,21 +240,20 @@ class IdealLRUPartReplPolicy : public PartReplPolicy {
 
 class IdealLRUPartArray : public CacheArray {
     private:
-        g_unordered_map<Address, uint32_t> lineMap; //address->lineId; if too slow, try an AATree, which does not alloc dynamically
+        LineIndex lineMap; //address->lineId
         Address* lineAddrs; //lineId -> address, for replacements
         IdealLRUPartReplPolicy* rp;
         uint32_t numLines;
 
     public:
-        IdealLRUPartArray(uint32_t _numLines, IdealLRUPartReplPolicy* _rp) : rp(_rp), numLines(_numLines) {
+        IdealLRUPartArray(uint32_t _numLines, IdealLRUPartReplPolicy* _rp) : lineMap(_numLines), rp(_rp), numLines(_numLines) {
             lineAddrs = gm_calloc<Address>(numLines);
         }
 
         int32_t lookup(const Address lineAddr, const MemReq* req, bool updateReplacement) {
-            g_unordered_map<Address, uint32_t>::iterator it = lineMap.find(lineAddr);
-            if (it == lineMap.end()) return -1;
+            int32_t lineId = lineMap.find(lineAddr);
+            if (lineId == -1) return -1;
 
-            uint32_t lineId = it->second;
             if (updateReplacement) {
                 rp->update(lineId, req);
             }
@@ -270,10 +268,10 @@ class IdealLRUPartArray : public CacheArray {
 
         void postinsert(const Address lineAddr, const MemReq* req, uint32_t lineId) {
             //Update addr mapping for lineId
-            lineMap.erase(lineAddrs[lineId]);
-            assert((lineMap.find(lineAddr) == lineMap.end()));
+            lineMap.erase(lineAddrs[lineId], lineId);
+            assert(lineMap.find(lineAddr) == -1);
             lineAddrs[lineId] = lineAddr;
-            lineMap[lineAddr] = lineId;
+            lineMap.insert(lineAddr, lineId);
 
             //Update repl
             rp->replaced(lineId);
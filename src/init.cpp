@@ -31,6 +31,7 @@
 #include <string>
 #include <sys/time.h>
 #include <vector>
+#include "bbv_profiler.h"
 #include "cache.h"
 #include "cache_arrays.h"
 #include "config.h"
@@ -43,6 +44,7 @@
 #include "filter_cache.h"
 #include "galloc.h"
 #include "hash.h"
+#include "host_prof.h"
 #include "ideal_arrays.h"
 #include "locks.h"
 #include "log.h"
@@ -51,8 +53,10 @@
 #include "CacheModel.h"
 #include "FetchModel.h"
 #include "IssueModel.h"
+#include "ReuseModel.h"
 #include "part_repl_policies.h"
 #include "pin_cmd.h"
+#include "placement.h"
 #include "proc_stats.h"
 #include "process_stats.h"
 #include "process_tree.h"
@@ -260,7 +264,8 @@ BaseCache* BuildCacheBank(Config& config, const string& prefix, g_string& name,
             uint32_t mshrs = config.get<uint32_t>(prefix + "mshrs", 16);
             uint32_t tagLat = config.get<uint32_t>(prefix + "tagLat", 5);
             uint32_t timingCandidates = config.get<uint32_t>(prefix + "timingCandidates", candidates);
-            cache = new TimingCache(numLines, cc, array, rp, accLat, invLat, mshrs, tagLat, ways, timingCandidates, domain, name);
+            bool elideHits = config.get<bool>(prefix + "elideHits", false);
+            cache = new TimingCache(numLines, cc, array, rp, accLat, invLat, mshrs, tagLat, ways, timingCandidates, domain, name, elideHits);
         } else {
             panic("Invalid cache type %s", type.c_str());
         }
@@ -564,6 +569,7 @@ static void InitSystem(Config& config) {
             CacheModel*  cacheCores;
             FetchModel*  fetchCores;
             IssueModel*  issueCores;
+            ReuseModel*  reuseCores;
         };
 
         if (type == "CacheModel") {
@@ -575,6 +581,9 @@ static void InitSystem(Config& config) {
         } else if (type == "IssueModel") {
             issueCores = gm_memalign<IssueModel>(CACHE_LINE_BYTES, cores);
             zinfo->oooDecode = true;
+        } else if (type == "ReuseModel") {
+            reuseCores = gm_memalign<ReuseModel>(CACHE_LINE_BYTES, cores);
+            zinfo->oooDecode = true;  // needed to instrument loads and stores
         } else {
             panic("%s: Invalid core type %s", group, type.c_str());
         }
@@ -646,6 +655,20 @@ static void InitSystem(Config& config) {
                 coreMap[group].push_back(core);
                 coreIdx++;
             }
+        } else if (type == "ReuseModel") {
+            uint32_t maxSamples = config.get<uint32_t>(prefix + "maxSamples", 8192);
+            double samplingRate = config.get<double>(prefix + "samplingRate", 0.01);
+
+            for (uint32_t j = 0; j < cores; j++) {
+                stringstream ss;
+                ss << group << "-" << j;
+                g_string name(ss.str().c_str());
+
+                // No timing model, so no event recorder (and no contention simulation)
+                ReuseModel* core = new (&reuseCores[j]) ReuseModel(maxSamples, samplingRate, name);
+                coreMap[group].push_back(core);
+                coreIdx++;
+            }
         }
     }
 
@@ -662,6 +685,11 @@ static void InitSystem(Config& config) {
     coreIdx = 0;
     for (const char* group : coreGroupNames) for (Core* core : coreMap[group]) zinfo->cores[coreIdx++] = core;
 
+    //Threads may run on any core, so instrument for all of them
+    zinfo->instrReqs = 0;
+    for (uint32_t i = 0; i < zinfo->numCores; i++) zinfo->instrReqs |= zinfo->cores[i]->GetInstrReqs();
+    info("Instrumenting memory accesses %s, branches %s", (zinfo->instrReqs & INSTR_REQ_MEM)? "ON" : "OFF", (zinfo->instrReqs & INSTR_REQ_BRANCH)? "ON" : "OFF");
+
     //Init stats: cores
     for (const char* group : coreGroupNames) {
         AggregateStat* groupStat = new AggregateStat(true);
@@ -711,7 +739,17 @@ static void PostInitStats(bool perProcessDir, Config& config) {
     const char* cmpStatsFile = gm_strdup((pathStr + "zsim-cmp.h5").c_str());
     const char* statsFile = gm_strdup((pathStr + "zsim.out").c_str());
 
-    zinfo->periodicStatsBackend = new HDF5Backend(pStatsFile, zinfo->rootStat, (1 << 20) /* 1MB chunks */, zinfo->skipStatsVectors, zinfo->compactPeriodicStats);
+    // Periodic stats: HDF5 by default, or delta-compressed blocks, which are much smaller for long runs (see delta_stats.h)
+    string periodicFormat = config.get<const char*>("sim.periodicStatsFormat", "hdf5");
+    if (periodicFormat == "hdf5") {
+        zinfo->periodicStatsBackend = new HDF5Backend(pStatsFile, zinfo->rootStat, (1 << 20) /* 1MB chunks */, zinfo->skipStatsVectors, zinfo->compactPeriodicStats);
+    } else if (periodicFormat == "delta") {
+        const char* dStatsFile = gm_strdup((pathStr + "zsim.dstats").c_str());
+        uint32_t keyframeInterval = config.get<uint32_t>("sim.periodicStatsKeyframe", 64);
+        zinfo->periodicStatsBackend = new DeltaBackend(dStatsFile, zinfo->rootStat, keyframeInterval, zinfo->skipStatsVectors, zinfo->compactPeriodicStats);
+    } else {
+        panic("Invalid sim.periodicStatsFormat %s, must be hdf5 or delta", periodicFormat.c_str());
+    }
 
     zinfo->eventualStatsBackend = new HDF5Backend(evStatsFile, zinfo->rootStat, (1 << 17) /* 128KB chunks */, zinfo->skipStatsVectors, false /* don't sum regular aggregates*/);
     zinfo->eventualStatsBackend->dump(true); //must have a first sample
@@ -799,7 +837,13 @@ void SimInit(Config config, const char* outputDir, uint32_t shmid, int32_t procI
 
     zinfo->numDomains = config.get<uint32_t>("sim.domains", 1);
     uint32_t numSimThreads = config.get<uint32_t>("sim.contentionThreads", MAX((uint32_t)1, zinfo->numDomains/2)); //gives a bit of parallelism, TODO tune
-    zinfo->contentionSim = new ContentionSim(zinfo->numDomains, numSimThreads);
+    uint32_t inlineWeaveEvents = config.get<uint32_t>("sim.inlineWeaveEvents", 64);  //0 always wakes up the sim threads
+    bool stealDomains = config.get<bool>("sim.stealDomains", true);  //idle sim threads take over domains from busy ones
+
+    //Host placement of simulator threads; binds the heap, so it must precede the bulk of the heap's allocations
+    zinfo->placement = CreatePlacement(config, numSimThreads, zinfo->harnessPid);
+
+    zinfo->contentionSim = new ContentionSim(zinfo->numDomains, numSimThreads, inlineWeaveEvents, stealDomains);
     zinfo->contentionSim->initStats(zinfo->rootStat);
     zinfo->eventRecorders = gm_calloc<EventRecorder*>(zinfo->numCores);
 
@@ -829,6 +873,9 @@ void SimInit(Config config, const char* outputDir, uint32_t shmid, int32_t procI
     zinfo->ffReinstrument = config.get<bool>("sim.ffReinstrument", false);
     if (zinfo->ffReinstrument) warn("sim.ffReinstrument = true, switching fast-forwarding on a multi-threaded process may be unstable");
 
+    zinfo->inferBranches = config.get<bool>("sim.inferBranches", true);
+    zinfo->bufferMemAddrs = config.get<bool>("sim.bufferMemAddrs", true);
+
     zinfo->registerThreads = config.get<bool>("sim.registerThreads", false);
     zinfo->globalPauseFlag = config.get<bool>("sim.startInGlobalPause", false);
 
@@ -884,6 +931,26 @@ void SimInit(Config config, const char* outputDir, uint32_t shmid, int32_t procI
         zinfo->procStats = nullptr;
     }
 
+    //Basic-block vectors, dumped alongside periodic stats at every slice boundary
+    if (config.get<bool>("sim.bbv.enable", false)) {
+        uint32_t maxBbls = config.get<uint32_t>("sim.bbv.maxBbls", 1 << 20);
+        uint32_t projDims = config.get<uint32_t>("sim.bbv.projDims", 0);  // 0 disables projection
+        uint64_t projSeed = config.get<uint64_t>("sim.bbv.projSeed", 0xB0BAC0DEULL);
+        zinfo->bbvProfiler = new BBVProfiler(zinfo->outputDir, maxBbls, projDims, projSeed);
+    } else {
+        zinfo->bbvProfiler = nullptr;
+    }
+
+    //Sampled host-time profile of the simulator itself
+    if (config.get<bool>("sim.hostProf.enable", false)) {
+        uint32_t samplePeriod = config.get<uint32_t>("sim.hostProf.samplePeriod", 64);  // time 1 in every samplePeriod entries per region
+        if (!samplePeriod) panic("sim.hostProf.samplePeriod must be > 0");
+        zinfo->hostProf = new HostProfiler(samplePeriod);
+        zinfo->hostProf->initStats(zinfo->rootStat);
+    } else {
+        zinfo->hostProf = nullptr;
+    }
+
     //It's a global stat, but I want it to be last...
     zinfo->profHeartbeats = new VectorCounter();
     zinfo->profHeartbeats->init("heartbeats", "Per-process heartbeats", zinfo->lineSize /*max procs*/);
@@ -894,6 +961,9 @@ void SimInit(Config config, const char* outputDir, uint32_t shmid, int32_t procI
 
     zinfo->perProcessCpuEnum = config.get<bool>("sim.perProcessCpuEnum", false);
 
+    //Live telemetry records for scripts/zsim_top.py; "" disables them
+    zinfo->telemetryDir = gm_strdup(config.get<const char*>("sim.telemetryDir", "/dev/shm/zsim-telemetry"));
+
     //Odds and ends
     bool printMemoryStats = config.get<bool>("sim.printMemoryStats", false);
     if (printMemoryStats) {
@@ -902,7 +972,8 @@ void SimInit(Config config, const char* outputDir, uint32_t shmid, int32_t procI
 
     //HACK: Read all variables that are read in the harness but not in init
     //This avoids warnings on those elements
-    config.get<uint32_t>("sim.gmMBytes", (1 << 10));
+    config.get<uint32_t>("sim.gmMBytes", GM_DEFAULT_MBYTES);
+    config.get<const char*>("sim.gmHugePages", "None");
     if (!zinfo->attachDebugger) config.get<bool>("sim.deadlockDetection", true);
     config.get<bool>("sim.aslr", false);
 
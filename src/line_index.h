@@ -0,0 +1,113 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LINE_INDEX_H_
+#define LINE_INDEX_H_
+
+#include <stdint.h>
+#include "bithacks.h"
+#include "galloc.h"
+#include "memory_hierarchy.h"
+
+/* Address -> lineId map for fully-associative arrays. Open addressing with
+ * Robin Hood probing and backward-shift deletion, so there are no
+ * tombstones even though every insertion also erases a line. The table is
+ * sized once (power of two, load factor <= 1/2) and never allocates again.
+ */
+class LineIndex {
+    private:
+        struct Slot {
+            Address lineAddr;
+            uint32_t lineId;
+            uint32_t dist; //0 if empty, else 1 + distance from the home slot
+        };
+
+        Slot* slots;
+        uint64_t mask;
+        uint32_t shift;
+
+        inline uint64_t home(Address lineAddr) const {
+            return (lineAddr * 0x9E3779B97F4A7C15UL) >> shift; //Fibonacci hashing
+        }
+
+        //Returns the slot holding lineAddr, or -1
+        inline int64_t findSlot(Address lineAddr) const {
+            uint64_t pos = home(lineAddr);
+            for (uint32_t dist = 1; ; dist++) {
+                const Slot& s = slots[pos];
+                //Empty, or an entry closer to its home --- lineAddr would have displaced it
+                if (s.dist < dist) return -1;
+                if (s.lineAddr == lineAddr) return pos;
+                pos = (pos + 1) & mask;
+            }
+        }
+
+    public:
+        explicit LineIndex(uint32_t numLines) {
+            uint64_t size = 2;
+            while (size < 2*(uint64_t)numLines) size *= 2;
+            slots = gm_calloc<Slot>(size); //zeroed, so all slots start empty
+            mask = size - 1;
+            shift = 64 - ilog2(size);
+        }
+
+        inline int32_t find(Address lineAddr) const {
+            int64_t pos = findSlot(lineAddr);
+            return (pos < 0)? -1 : slots[pos].lineId;
+        }
+
+        //lineAddr must not be in the index
+        inline void insert(Address lineAddr, uint32_t lineId) {
+            Slot cur = {lineAddr, lineId, 1};
+            uint64_t pos = home(lineAddr);
+            while (slots[pos].dist) {
+                if (slots[pos].dist < cur.dist) {
+                    Slot tmp = slots[pos];
+                    slots[pos] = cur;
+                    cur = tmp;
+                }
+                pos = (pos + 1) & mask;
+                cur.dist++;
+            }
+            slots[pos] = cur;
+        }
+
+        //Only erases lineAddr if it maps to lineId (evicted lines may hold stale addresses)
+        inline void erase(Address lineAddr, uint32_t lineId) {
+            int64_t p = findSlot(lineAddr);
+            if (p < 0 || slots[p].lineId != lineId) return;
+            uint64_t pos = p;
+            uint64_t next = (pos + 1) & mask;
+            while (slots[next].dist > 1) {
+                slots[pos] = slots[next];
+                slots[pos].dist--;
+                pos = next;
+                next = (next + 1) & mask;
+            }
+            slots[pos].dist = 0;
+        }
+};
+
+#endif  // LINE_INDEX_H_
@@ -0,0 +1,228 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "placement.h"
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+#include "config.h"
+#include "log.h"
+
+// From numaif.h, which would add a libnuma dependency just for these
+#define PL_MPOL_PREFERRED 1
+#define PL_MPOL_BIND 2
+#define PL_MPOL_INTERLEAVE 3
+#define PL_MPOL_MF_MOVE (1 << 1)
+#define PL_MAX_NODES 64
+
+/* Host topology, from sysfs. Local vectors, only used at initialization */
+
+struct HostCpu {
+    uint32_t cpu;
+    uint32_t socket;
+    uint32_t core; //core_id, unique within its socket
+    uint32_t node;
+};
+
+static uint32_t readSysfsInt(const std::string& path, uint32_t def) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return def;
+    uint32_t val;
+    if (fscanf(f, "%u", &val) != 1) val = def;
+    fclose(f);
+    return val;
+}
+
+static uint32_t cpuNode(uint32_t cpu) {
+    //cpuN has a nodeM link to its NUMA node; there is none on non-NUMA kernels
+    std::string dirName = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(dirName.c_str());
+    if (!dir) return 0;
+    uint32_t node = 0;
+    while (struct dirent* ent = readdir(dir)) {
+        uint32_t n;
+        char c;
+        if (sscanf(ent->d_name, "node%u%c", &n, &c) == 1) {
+            node = n;
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+// CPUs in the calling thread's affinity mask
+static std::vector<HostCpu> allowedCpus() {
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) != 0) panic("sched_getaffinity failed");
+    std::vector<HostCpu> cpus;
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &mask)) continue;
+        std::string topo = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        HostCpu hc = {cpu, readSysfsInt(topo + "physical_package_id", 0), readSysfsInt(topo + "core_id", cpu), cpuNode(cpu)};
+        cpus.push_back(hc);
+    }
+    if (cpus.empty()) panic("Empty affinity mask?");
+    return cpus;
+}
+
+static std::vector<uint32_t> socketsOf(const std::vector<HostCpu>& cpus) {
+    std::vector<uint32_t> sockets;
+    for (const HostCpu& hc : cpus) sockets.push_back(hc.socket);
+    std::sort(sockets.begin(), sockets.end());
+    sockets.erase(std::unique(sockets.begin(), sockets.end()), sockets.end());
+    return sockets;
+}
+
+static uint32_t chooseSocket(const std::vector<HostCpu>& cpus, int32_t socket, uint32_t harnessPid) {
+    std::vector<uint32_t> sockets = socketsOf(cpus);
+    if (socket < 0) return sockets[harnessPid % sockets.size()];
+    if (std::find(sockets.begin(), sockets.end(), (uint32_t)socket) == sockets.end()) {
+        panic("sim.placement.socket = %d, but there are no allowed CPUs on that socket", socket);
+    }
+    return socket;
+}
+
+static PlacementPolicy readPolicy(Config& config) {
+    std::string policy = config.get<const char*>("sim.placement.policy", "None");
+    if (policy == "None") return PL_NONE;
+    else if (policy == "Compact") return PL_COMPACT;
+    else if (policy == "Spread") return PL_SPREAD;
+    else if (policy == "Socket") return PL_SOCKET;
+    panic("Invalid sim.placement.policy %s (None, Compact, Spread or Socket)", policy.c_str());
+}
+
+static const char* policyName(PlacementPolicy policy) {
+    const char* names[] = {"None", "Compact", "Spread", "Socket"};
+    return names[policy];
+}
+
+/* HostPlacement */
+
+HostPlacement::HostPlacement(PlacementPolicy _policy, int32_t socket, uint32_t _numContentionThreads, uint32_t harnessPid)
+    : policy(_policy), numContentionThreads(_numContentionThreads), nextAppSlot(0), nodeMask(0)
+{
+    assert(policy != PL_NONE);
+    std::vector<HostCpu> cpus = allowedCpus();
+    if (policy == PL_SOCKET) {
+        uint32_t s = chooseSocket(cpus, socket, harnessPid);
+        cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [s](const HostCpu& hc) { return hc.socket != s; }), cpus.end());
+    }
+
+    //Group hyperthreads into physical cores, ordered by (socket, core)
+    std::sort(cpus.begin(), cpus.end(), [](const HostCpu& a, const HostCpu& b) {
+        return std::make_tuple(a.socket, a.core, a.cpu) < std::make_tuple(b.socket, b.core, b.cpu);
+    });
+    std::vector<PhysCore> phys;
+    std::vector<uint32_t> rank; //position of each core within its socket
+    for (uint32_t i = 0; i < cpus.size(); i++) {
+        const HostCpu& hc = cpus[i];
+        if (i == 0 || cpus[i-1].socket != hc.socket || cpus[i-1].core != hc.core) {
+            PhysCore pc;
+            pc.socket = hc.socket;
+            pc.node = hc.node;
+            CPU_ZERO(&pc.cpus);
+            rank.push_back((phys.empty() || phys.back().socket != hc.socket)? 0 : rank.back() + 1);
+            phys.push_back(pc);
+        }
+        CPU_SET(hc.cpu, &phys.back().cpus);
+    }
+
+    //Spread interleaves sockets: first core of each socket, then the second ones, etc.
+    std::vector<uint32_t> order(phys.size());
+    for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+    if (policy == PL_SPREAD) {
+        std::stable_sort(order.begin(), order.end(), [&rank](uint32_t a, uint32_t b) { return rank[a] < rank[b]; });
+    }
+
+    numCores = phys.size();
+    cores = gm_calloc<PhysCore>(numCores);
+    for (uint32_t i = 0; i < numCores; i++) cores[i] = phys[order[i]];
+
+    //Compact prefers the first core's node and spills over; Socket and Spread use the nodes of all their cores
+    for (uint32_t i = 0; i < numCores; i++) {
+        if (policy == PL_COMPACT && cores[i].node != cores[0].node) continue;
+        if (cores[i].node >= PL_MAX_NODES) panic("NUMA node %d, at most %d supported", cores[i].node, PL_MAX_NODES);
+        nodeMask |= 1ul << cores[i].node;
+    }
+
+    info("Placement: %s, %d physical cores on %ld socket(s), first on socket %d, heap nodes 0x%lx",
+            policyName(policy), numCores, socketsOf(cpus).size(), cores[0].socket, nodeMask);
+}
+
+void HostPlacement::bindHeap() {
+    int mode = (policy == PL_COMPACT)? PL_MPOL_PREFERRED : (policy == PL_SPREAD)? PL_MPOL_INTERLEAVE : PL_MPOL_BIND;
+    unsigned long mask = nodeMask;
+    //Pages touched so far (allocator metadata, a few structures) are moved if only we map them; the rest is faulted in under the policy
+    if (gm_mbind(mode, &mask, PL_MAX_NODES + 1, PL_MPOL_MF_MOVE) != 0) {
+        warn("Placement: mbind on the global heap failed (%s), heap pages will be first-touch", strerror(errno));
+    }
+}
+
+void HostPlacement::pin(uint32_t slot, const char* what, uint32_t id) {
+    const PhysCore& pc = cores[slot % numCores];
+    if (sched_setaffinity(0 /*calling thread*/, sizeof(cpu_set_t), &pc.cpus) != 0) {
+        warn("Placement: could not pin %s %d (%s)", what, id, strerror(errno));
+    } else {
+        info("Placement: %s %d on socket %d, physical core %d of %d in placement order", what, id, pc.socket, slot % numCores, numCores);
+    }
+}
+
+void HostPlacement::placeContentionThread(uint32_t thid) {
+    pin(thid, "contention thread", thid);
+}
+
+void HostPlacement::placeAppThread(uint32_t tid) {
+    pin(numContentionThreads + __sync_fetch_and_add(&nextAppSlot, 1), "app thread", tid);
+}
+
+HostPlacement* CreatePlacement(Config& config, uint32_t numContentionThreads, uint32_t harnessPid) {
+    PlacementPolicy policy = readPolicy(config);
+    int32_t socket = config.get<int>("sim.placement.socket", -1);
+    if (policy == PL_NONE) return nullptr;
+    HostPlacement* placement = new HostPlacement(policy, socket, numContentionThreads, harnessPid);
+    if (config.get<bool>("sim.placement.bindHeap", true)) placement->bindHeap();
+    return placement;
+}
+
+void ConfineJobToSocket(Config& config) {
+    if (readPolicy(config) != PL_SOCKET) return;
+    std::vector<HostCpu> cpus = allowedCpus();
+    uint32_t socket = chooseSocket(cpus, config.get<int>("sim.placement.socket", -1), getpid());
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (const HostCpu& hc : cpus) {
+        if (hc.socket == socket) CPU_SET(hc.cpu, &mask);
+    }
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0) panic("Could not confine job to socket %d", socket);
+    info("Placement: job confined to socket %d (%d CPUs)", socket, CPU_COUNT(&mask));
+}
@@ -0,0 +1,92 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PLACEMENT_H_
+#define PLACEMENT_H_
+
+#include <sched.h>
+#include <stdint.h>
+#include "galloc.h"
+
+class Config;
+
+/* Host placement of simulator threads and of the global heap (sim.placement).
+ *
+ * When many jobs share a multi-socket node, letting threads float means the
+ * contention threads, the app threads, and the heap pages they share (tag
+ * arrays, event queues) end up on different sockets. Policies:
+ *  - None: leave everything to the OS (default).
+ *  - Compact: fill the physical cores of one socket before moving to the next;
+ *    the heap prefers the first socket's node.
+ *  - Spread: round-robin threads across sockets; the heap is interleaved
+ *    across their nodes.
+ *  - Socket: confine the whole job to one socket (sim.placement.socket, or -1
+ *    to pick one by harness pid), and bind the heap to its node. The harness
+ *    confines itself before launching Pin, so every thread of the job inherits it.
+ * Threads get a physical core each, and may use all of its hyperthreads (this
+ * did ~20% better than pinning to one hyperthread for the contention threads).
+ * Contention thread i takes the i-th core in policy order, and app threads take
+ * the following ones as they start, wrapping around if there are more threads
+ * than cores. Only CPUs in the harness's affinity mask are used, so taskset or
+ * cgroup limits are respected.
+ */
+
+enum PlacementPolicy {PL_NONE, PL_COMPACT, PL_SPREAD, PL_SOCKET};
+
+class HostPlacement : public GlobAlloc {
+    private:
+        struct PhysCore {
+            uint32_t socket;
+            uint32_t node;
+            cpu_set_t cpus; //its allowed hyperthreads
+        };
+
+        PlacementPolicy policy;
+        PhysCore* cores; //in placement order
+        uint32_t numCores;
+        uint32_t numContentionThreads;
+        volatile uint32_t nextAppSlot;
+        uint64_t nodeMask; //nodes used by the policy
+
+        void pin(uint32_t slot, const char* what, uint32_t id);
+
+    public:
+        HostPlacement(PlacementPolicy _policy, int32_t socket, uint32_t _numContentionThreads, uint32_t harnessPid);
+
+        // Sets the global heap's memory policy. Call before most of the heap is allocated
+        void bindHeap();
+
+        // Both pin the calling thread
+        void placeContentionThread(uint32_t thid);
+        void placeAppThread(uint32_t tid);
+};
+
+// Returns nullptr with sim.placement.policy = "None"
+HostPlacement* CreatePlacement(Config& config, uint32_t numContentionThreads, uint32_t harnessPid);
+
+// Harness side: with the Socket policy, confines the calling process (and so every process it launches afterwards) to the job's socket
+void ConfineJobToSocket(Config& config);
+
+#endif  // PLACEMENT_H_
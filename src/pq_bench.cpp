@@ -0,0 +1,301 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* pqbench: compares PrioQueue against the multimap-based queue it replaced, by
+ * replaying recorded queue operations on both.
+ * Usage: pqbench [-r reps] trace.bin...
+ *        pqbench -g ops liveEvents farFraction out.bin
+ * Traces are the pqtrace-<domain>.bin files that zsim dumps with TRACE_PQ
+ * (contention_sim.h): raw uint64_t entries, each an enqueue cycle or
+ * PQ_TRACE_DEQUEUE. Every dequeue is preceded by a firstCycle() call, as in the
+ * weave phase. Both queues must dequeue the same cycles; the tool reports the
+ * best of reps runs per queue, in ns per operation.
+ *
+ * -g writes a synthetic trace instead: liveEvents events, each re-enqueued
+ * after it is dequeued, with a delay of 1-100 cycles (89%), 100-2100 cycles
+ * (10%), or, for farFraction of them, 64K-4M cycles (beyond the near window).
+ *
+ * The old queue uses std::multimap. In zsim it used g_multimap, which
+ * allocates from the locked global heap, so its real cost is higher.
+ */
+
+#include <chrono>
+#include <map>
+#include <random>
+#include <set>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "prio_queue.h"
+
+#define BENCH_PQ_BLOCKS 1024  // as PQ_BLOCKS in contention_sim.h
+
+struct BenchEvent {
+    BenchEvent* next;
+    uint64_t pqCycle;
+};
+
+// The queue before the timing wheel: far events go in a multimap, swept into the blocks every B/2 blocks
+template <typename T, uint32_t B>
+class MultimapPrioQueue {
+    struct PQBlock {
+        T* array[64];
+        uint64_t occ;
+
+        PQBlock() {
+            for (uint32_t i = 0; i < 64; i++) array[i] = nullptr;
+            occ = 0;
+        }
+
+        inline T* dequeue(uint32_t& offset) {
+            uint32_t pos = __builtin_ctzl(occ);
+            T* res = array[pos];
+            T* next = res->next;
+            array[pos] = next;
+            if (!next) occ ^= 1L << pos;
+            offset = pos;
+            res->next = nullptr;
+            return res;
+        }
+
+        inline void enqueue(T* obj, uint32_t pos) {
+            occ |= 1L << pos;
+            obj->next = array[pos];
+            array[pos] = obj;
+        }
+    };
+
+    PQBlock blocks[B];
+    std::multimap<uint64_t, T*> feMap;
+    uint64_t curBlock;
+    uint64_t elems;
+
+    public:
+        MultimapPrioQueue() : curBlock(0), elems(0) {}
+
+        void enqueue(T* obj, uint64_t cycle) {
+            uint64_t absBlock = cycle/64;
+            if (absBlock < curBlock + B) {
+                blocks[absBlock % B].enqueue(obj, cycle % 64);
+            } else {
+                feMap.insert(std::make_pair(cycle, obj));
+            }
+            elems++;
+        }
+
+        T* dequeue(uint64_t& deqCycle) {
+            while (!blocks[curBlock % B].occ) {
+                curBlock++;
+                if ((curBlock % (B/2)) == 0 && !feMap.empty()) {
+                    uint64_t topCycle = (curBlock + B)*64;
+                    auto it = feMap.begin();
+                    while (it != feMap.end() && it->first < topCycle) {
+                        blocks[(it->first/64) % B].enqueue(it->second, it->first % 64);
+                        it++;
+                    }
+                    feMap.erase(feMap.begin(), it);
+                }
+            }
+            uint32_t offset;
+            T* obj = blocks[curBlock % B].dequeue(offset);
+            elems--;
+            deqCycle = curBlock*64 + offset;
+            return obj;
+        }
+
+        inline uint64_t size() const {
+            return elems;
+        }
+
+        inline uint64_t firstCycle() const {
+            for (uint32_t i = 0; i < B/2; i++) {
+                uint64_t occ = blocks[(curBlock + i) % B].occ;
+                if (occ) return (curBlock + i)*64 + __builtin_ctzl(occ);
+            }
+            for (uint32_t i = B/2; i < B; i++) {
+                uint64_t occ = blocks[(curBlock + i) % B].occ;
+                if (occ) {
+                    uint64_t cycle = (curBlock + i)*64 + __builtin_ctzl(occ);
+                    return feMap.empty()? cycle : MIN(cycle, feMap.begin()->first);
+                }
+            }
+            return feMap.begin()->first;
+        }
+};
+
+struct RunResult {
+    double nsPerOp;
+    uint64_t checksum;  // over dequeued cycles
+};
+
+template <typename Q>
+static RunResult replay(const std::vector<uint64_t>& trace, uint64_t maxLive) {
+    std::vector<BenchEvent> events(maxLive);
+    std::vector<BenchEvent*> freeList;
+    for (BenchEvent& e : events) {
+        e.next = nullptr;
+        freeList.push_back(&e);
+    }
+    Q* pq = new Q();  // too large for the stack
+
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t op : trace) {
+        if (op == PQ_TRACE_DEQUEUE) {
+            uint64_t first = pq->firstCycle();
+            uint64_t cycle;
+            freeList.push_back(pq->dequeue(cycle));
+            if (cycle != first) {
+                fprintf(stderr, "firstCycle() %ld != dequeued cycle %ld\n", first, cycle);
+                exit(1);
+            }
+            checksum = checksum*31 + cycle;
+        } else {
+            BenchEvent* e = freeList.back();
+            freeList.pop_back();
+            pq->enqueue(e, op);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    delete pq;
+    return {std::chrono::duration<double, std::nano>(end - start).count() / trace.size(), checksum};
+}
+
+// Checks that the trace is well formed, and returns the maximum number of queued events
+static bool checkTrace(const std::vector<uint64_t>& trace, uint64_t& maxLive) {
+    std::multiset<uint64_t> queued;
+    uint64_t lastCycle = 0;
+    maxLive = 0;
+    for (uint64_t op : trace) {
+        if (op == PQ_TRACE_DEQUEUE) {
+            if (queued.empty()) return false;
+            lastCycle = *queued.begin();
+            queued.erase(queued.begin());
+        } else {
+            if (op < lastCycle) return false;
+            queued.insert(op);
+            maxLive = MAX(maxLive, (uint64_t)queued.size());
+        }
+    }
+    return true;
+}
+
+static void generate(uint64_t ops, uint64_t live, double farFraction, const char* file) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    auto delay = [&]() -> uint64_t {
+        double r = uniform(rng);
+        if (r < farFraction) return 65536 + rng() % (4u << 20);
+        if (r < farFraction + 0.1) return 100 + rng() % 2000;
+        return 1 + rng() % 100;
+    };
+
+    std::vector<uint64_t> trace;
+    std::multiset<uint64_t> queued;
+    for (uint64_t i = 0; i < live; i++) {
+        uint64_t cycle = delay();
+        queued.insert(cycle);
+        trace.push_back(cycle);
+    }
+    while (trace.size() + 2 <= ops) {
+        uint64_t cycle = *queued.begin();
+        queued.erase(queued.begin());
+        trace.push_back(PQ_TRACE_DEQUEUE);
+        uint64_t next = cycle + delay();
+        queued.insert(next);
+        trace.push_back(next);
+    }
+
+    FILE* f = fopen(file, "w");
+    if (!f || fwrite(&trace[0], sizeof(uint64_t), trace.size(), f) != trace.size()) {
+        fprintf(stderr, "Could not write %s\n", file);
+        exit(1);
+    }
+    fclose(f);
+    printf("Wrote %ld operations to %s\n", trace.size(), file);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-r reps] trace.bin...\n       %s -g ops liveEvents farFraction out.bin\n", prog, prog);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t reps = 5;
+    int i = 1;
+    if (i < argc && std::string(argv[i]) == "-g") {
+        if (argc != 6) usage(argv[0]);
+        generate(strtoull(argv[2], nullptr, 0), strtoull(argv[3], nullptr, 0), atof(argv[4]), argv[5]);
+        return 0;
+    }
+    if (i + 1 < argc && std::string(argv[i]) == "-r") {
+        reps = atoi(argv[i+1]);
+        i += 2;
+    }
+    if (i >= argc || reps == 0) usage(argv[0]);
+
+    typedef MultimapPrioQueue<BenchEvent, BENCH_PQ_BLOCKS> OldQueue;
+    typedef PrioQueue<BenchEvent, BENCH_PQ_BLOCKS> NewQueue;
+
+    printf("%-32s %10s %8s %12s %12s %8s\n", "trace", "ops", "maxLive", "old ns/op", "new ns/op", "speedup");
+    int res = 0;
+    for (; i < argc; i++) {
+        FILE* f = fopen(argv[i], "r");
+        if (!f) {
+            fprintf(stderr, "Could not open %s\n", argv[i]);
+            return 1;
+        }
+        std::vector<uint64_t> trace;
+        uint64_t buf[4096];
+        size_t n;
+        while ((n = fread(buf, sizeof(uint64_t), 4096, f)) > 0) trace.insert(trace.end(), buf, buf + n);
+        fclose(f);
+
+        uint64_t maxLive;
+        if (trace.empty() || !checkTrace(trace, maxLive)) {
+            fprintf(stderr, "%s: not a valid queue trace\n", argv[i]);
+            res = 1;
+            continue;
+        }
+
+        RunResult bestOld = {1e30, 0};
+        RunResult bestNew = {1e30, 0};
+        for (uint32_t r = 0; r < reps; r++) {
+            RunResult o = replay<OldQueue>(trace, maxLive);
+            RunResult w = replay<NewQueue>(trace, maxLive);
+            if (o.checksum != w.checksum) {
+                fprintf(stderr, "%s: queues dequeued different cycles\n", argv[i]);
+                return 1;
+            }
+            if (o.nsPerOp < bestOld.nsPerOp) bestOld = o;
+            if (w.nsPerOp < bestNew.nsPerOp) bestNew = w;
+        }
+        printf("%-32s %10ld %8ld %12.1f %12.1f %7.2fx\n", argv[i], trace.size(), maxLive,
+                bestOld.nsPerOp, bestNew.nsPerOp, bestOld.nsPerOp / bestNew.nsPerOp);
+    }
+    return res;
+}
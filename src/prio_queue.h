@@ -26,7 +26,23 @@
 #ifndef PRIO_QUEUE_H_
 #define PRIO_QUEUE_H_
 
-#include "g_std/g_multimap.h"
+#include <stdint.h>
+#include "bithacks.h"
+#include "log.h"
+
+/* Bucketed priority queue for timing events. Events in the current page of B
+ * 64-cycle blocks go in per-cycle buckets, indexed by occupancy bitmaps. Later
+ * events go in a hierarchical timing wheel of PQ_FAR_LEVELS levels with 64
+ * slots each: level l holds events in later slots (B*64^l blocks) of the
+ * current level-(l+1) slot, and the top level holds up to 63 slots ahead.
+ * When dequeue moves to a new page, the slots that now cover the current
+ * position are cascaded down. Events are linked through T::next and remember
+ * their cycle in T::pqCycle, so the queue never allocates.
+ */
+#define PQ_FAR_LEVELS 4
+
+// Dequeue marker in queue operation traces (TRACE_PQ in contention_sim.h); other entries are enqueue cycles
+#define PQ_TRACE_DEQUEUE (~0ul)
 
 template <typename T, uint32_t B>
 class PrioQueue {
@@ -60,58 +76,93 @@ class PrioQueue {
         }
     };
 
-    PQBlock blocks[B];
+    struct FarLevel {
+        T* slots[64];
+        uint64_t occ;
 
-    typedef g_multimap<uint64_t, T*> FEMap; //far element map
-    typedef typename FEMap::iterator FEMapIterator;
+        FarLevel() {
+            for (uint32_t i = 0; i < 64; i++) slots[i] = nullptr;
+            occ = 0;
+        }
 
-    FEMap feMap;
+        inline void enqueue(T* obj, uint32_t slot) {
+            occ |= 1L << slot;
+            assert(!obj->next);
+            obj->next = slots[slot];
+            slots[slot] = obj;
+        }
+
+        inline T* take(uint32_t slot) {
+            T* res = slots[slot];
+            slots[slot] = nullptr;
+            occ &= ~(1L << slot);
+            return res;
+        }
+    };
+
+    PQBlock blocks[B];
+    FarLevel far[PQ_FAR_LEVELS];
 
     uint64_t curBlock;
     uint64_t elems;
+    uint64_t nearElems; // elements in blocks[], i.e., in the current page
+
+    // Blocks covered by each slot of far level l
+    static inline uint64_t slotBlocks(uint32_t l) {
+        return ((uint64_t)B) << (6*l);
+    }
+
+    inline void place(T* obj, uint64_t cycle) {
+        uint64_t absBlock = cycle/64;
+        if (absBlock/B == curBlock/B) {
+            blocks[absBlock % B].enqueue(obj, cycle % 64);
+            nearElems++;
+        } else {
+            // Lowest level whose parent slot is the current one
+            uint32_t l = 0;
+            while (l < PQ_FAR_LEVELS-1 && absBlock/slotBlocks(l+1) != curBlock/slotBlocks(l+1)) l++;
+            uint64_t absSlot = absBlock/slotBlocks(l);
+            assert_msg(absSlot - curBlock/slotBlocks(l) < 64, "PrioQueue: cycle %ld is beyond the timing wheel (curBlock %ld)", cycle, curBlock);
+            obj->pqCycle = cycle;
+            far[l].enqueue(obj, absSlot % 64);
+        }
+    }
+
+    // Called when curBlock enters a new page: re-places the events of every far slot that now covers it
+    void cascade() {
+        for (int32_t l = PQ_FAR_LEVELS-1; l >= 0; l--) {
+            if (curBlock % slotBlocks(l)) continue;
+            T* obj = far[l].take((curBlock/slotBlocks(l)) % 64);
+            while (obj) {
+                T* next = obj->next;
+                obj->next = nullptr;
+                place(obj, obj->pqCycle);
+                obj = next;
+            }
+        }
+    }
 
     public:
         PrioQueue() {
             curBlock = 0;
             elems = 0;
+            nearElems = 0;
         }
 
         void enqueue(T* obj, uint64_t cycle) {
-            uint64_t absBlock = cycle/64;
-            assert(absBlock >= curBlock);
-
-            if (absBlock < curBlock + B) {
-                uint32_t i = absBlock % B;
-                uint32_t offset = cycle % 64;
-                blocks[i].enqueue(obj, offset);
-            } else {
-                //info("XXX far enq() %ld", cycle);
-                feMap.insert(std::pair<uint64_t, T*>(cycle, obj));
-            }
+            assert(cycle/64 >= curBlock);
+            place(obj, cycle);
             elems++;
         }
 
         T* dequeue(uint64_t& deqCycle) {
             assert(elems);
             while (!blocks[curBlock % B].occ) {
-                curBlock++;
-                if ((curBlock % (B/2)) == 0 && !feMap.empty()) {
-                    uint64_t topCycle = (curBlock + B)*64;
-                    //Move every element with cycle < topCycle to blocks[]
-                    FEMapIterator it = feMap.begin();
-                    while (it != feMap.end() && it->first < topCycle) {
-                        uint64_t cycle = it->first;
-                        T* obj = it->second;
-
-                        uint64_t absBlock = cycle/64;
-                        assert(absBlock >= curBlock);
-                        assert(absBlock < curBlock + B);
-                        uint32_t i = absBlock % B;
-                        uint32_t offset = cycle % 64;
-                        blocks[i].enqueue(obj, offset);
-                        it++;
-                    }
-                    feMap.erase(feMap.begin(), it);
+                if (nearElems) {
+                    curBlock++;  // still within the current page
+                } else {
+                    curBlock = (curBlock/B + 1)*B;  // skip the rest of the (empty) page
+                    cascade();
                 }
             }
 
@@ -119,6 +170,7 @@ class PrioQueue {
             uint32_t offset;
             T* obj = blocks[curBlock % B].dequeue(offset);
             elems--;
+            nearElems--;
 
             deqCycle = curBlock*64 + offset;
             return obj;
@@ -130,23 +182,33 @@ class PrioQueue {
 
         inline uint64_t firstCycle() const {
             assert(elems);
-            for (uint32_t i = 0; i < B/2; i++) {
-                uint64_t occ = blocks[(curBlock + i) % B].occ;
-                if (occ) {
-                    uint64_t pos = __builtin_ctzl(occ);
-                    return (curBlock + i)*64 + pos;
+            if (nearElems) {
+                for (uint64_t b = curBlock; b < (curBlock/B + 1)*B; b++) {
+                    uint64_t occ = blocks[b % B].occ;
+                    if (occ) return b*64 + __builtin_ctzl(occ);
                 }
+                panic("PrioQueue: %ld near elements but empty page", nearElems);
             }
-            for (uint32_t i = B/2; i < B; i++) { //beyond B/2 blocks, there may be a far element that comes earlier
-                uint64_t occ = blocks[(curBlock + i) % B].occ;
-                if (occ) {
-                    uint64_t pos = __builtin_ctzl(occ);
-                    uint64_t cycle = (curBlock + i)*64 + pos;
-                    return feMap.empty()? cycle : MIN(cycle, feMap.begin()->first);
+
+            // Each level only holds events later than all lower levels, and
+            // below the top level, slots are in cycle order
+            for (uint32_t l = 0; l < PQ_FAR_LEVELS; l++) {
+                uint64_t occ = far[l].occ;
+                if (!occ) continue;
+                uint32_t slot;
+                if (l < PQ_FAR_LEVELS-1) {
+                    slot = __builtin_ctzl(occ);
+                } else {
+                    // Top level wraps around; start from the slot after the current one
+                    uint32_t start = (curBlock/slotBlocks(l) + 1) % 64;
+                    uint64_t rot = start? ((occ >> start) | (occ << (64 - start))) : occ;
+                    slot = (start + __builtin_ctzl(rot)) % 64;
                 }
+                uint64_t minCycle = -1L;
+                for (T* obj = far[l].slots[slot]; obj; obj = obj->next) minCycle = MIN(minCycle, obj->pqCycle);
+                return minCycle;
             }
-
-            return feMap.begin()->first;
+            panic("PrioQueue: %ld elements but all levels empty", elems);
         }
 };
 
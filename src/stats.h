@@ -414,4 +414,16 @@ class HDF5Backend : public StatsBackend {
         virtual void dump(bool buffered);
 };
 
+
+class DeltaBackendImpl;
+
+class DeltaBackend : public StatsBackend {
+    private:
+        DeltaBackendImpl* backend;
+
+    public:
+        DeltaBackend(const char* filename, AggregateStat* rootStat, uint32_t recordsPerBlock, bool skipVectors, bool sumRegularAggregates);
+        virtual void dump(bool buffered);
+};
+
 #endif  // STATS_H_
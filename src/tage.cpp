@@ -1,5 +1,6 @@
 #include "tage.h"
 #include "mybitset.h"
+#include "host_prof.h"
 #include <cassert>
 
 /////////////// STORAGE BUDGET JUSTIFICATION ////////////////
@@ -57,6 +58,7 @@ BranchPredictorTage::BranchPredictorTage(uint8_t _table_num, uint8_t _index_size
 /////////////////////////////////////////////////////////////
 
 bool BranchPredictorTage::predict(uint64_t branchPc, bool taken, uint64_t branch_target) {
+    HOST_PROF_SCOPE(HP_BPRED);
     // predict
     bool pred = GetPrediction(branchPc);
     // update
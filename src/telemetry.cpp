@@ -0,0 +1,143 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "telemetry.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "galloc.h"
+#include "locks.h"
+#include "log.h"
+#include "profile_stats.h"
+#include "zsim.h"
+
+// Process-local: every process, including forked children, maps its own record
+static TelemetryRecord* rec = nullptr;
+static char recPath[512];
+// KIPS bookkeeping; several threads of this process may update concurrently, so guarded by updateLock
+static lock_t updateLock;
+static uint64_t lastInstrs = 0;
+static uint64_t lastNs = 0;
+static uint64_t nextUpdatePhase = 0;
+
+#define TSTORE(field, val) __atomic_store_n(&rec->field, (val), __ATOMIC_RELAXED)
+
+void TelemetryInit(const char* dir, uint32_t procIdx) {
+    // After a fork, the child inherits the parent's mapping; drop it, but keep the parent's file
+    if (rec) munmap(rec, sizeof(TelemetryRecord));
+    rec = nullptr;
+    if (!dir || !dir[0]) return;
+
+    mkdir(dir, 0777);  // may already exist; open() below catches real errors
+    snprintf(recPath, sizeof(recPath), "%s/%d.tel", dir, getpid());
+    int fd = open(recPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        warn("Telemetry: could not create %s, disabling", recPath);
+        return;
+    }
+    if (ftruncate(fd, sizeof(TelemetryRecord)) != 0) {
+        warn("Telemetry: could not size %s, disabling", recPath);
+        close(fd);
+        unlink(recPath);
+        return;
+    }
+    void* m = mmap(nullptr, sizeof(TelemetryRecord), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        warn("Telemetry: could not map %s, disabling", recPath);
+        unlink(recPath);
+        return;
+    }
+
+    rec = static_cast<TelemetryRecord*>(m);  // zero-filled by ftruncate
+    rec->version = TELEMETRY_VERSION;
+    rec->procIdx = procIdx;
+    rec->pid = getpid();
+    futex_init(&updateLock);
+    rec->startNs = rec->updateNs = lastNs = getNs();
+    lastInstrs = 0;
+    nextUpdatePhase = zinfo->numPhases + TELEMETRY_PHASE_INTERVAL;
+    rec->heapBytes = gm_segment_size();
+    strncpy(rec->outputDir, zinfo->outputDir, sizeof(rec->outputDir) - 1);
+    __atomic_store_n(&rec->magic, TELEMETRY_MAGIC, __ATOMIC_RELEASE);
+    info("Telemetry record at %s", recPath);
+}
+
+// Caller holds updateLock
+static void DoUpdate(uint64_t instrs) {
+    uint64_t curNs = getNs();
+    // instrs may lag lastInstrs if another thread sampled the count later but updated first
+    if (instrs >= lastInstrs && curNs > lastNs) {
+        TSTORE(hostKips, (instrs - lastInstrs)*1000000ul/(curNs - lastNs));
+        lastInstrs = instrs;
+        lastNs = curNs;
+    }
+
+    TSTORE(instrs, instrs);
+    TSTORE(phases, zinfo->numPhases);
+    TSTORE(boundNs, zinfo->profSimTime->count(PROF_BOUND));
+    TSTORE(weaveNs, zinfo->profSimTime->count(PROF_WEAVE));
+    TSTORE(ffNs, zinfo->profSimTime->count(PROF_FF));
+    TSTORE(heapUsedBytes, gm_footprint());
+    TSTORE(updateNs, curNs);
+}
+
+void TelemetryUpdate(uint64_t instrs) {
+    if (!rec) return;
+    futex_lock(&updateLock);
+    DoUpdate(instrs);
+    futex_unlock(&updateLock);
+}
+
+void TelemetryPhaseTick(uint64_t instrs) {
+    if (!rec) return;
+    uint64_t phase = zinfo->numPhases;
+    if (likely(phase < __atomic_load_n(&nextUpdatePhase, __ATOMIC_RELAXED))) return;
+    futex_lock(&updateLock);
+    if (phase >= nextUpdatePhase) {  // other threads of this process may have passed the same barrier
+        __atomic_store_n(&nextUpdatePhase, phase - phase % TELEMETRY_PHASE_INTERVAL + TELEMETRY_PHASE_INTERVAL, __ATOMIC_RELAXED);
+        DoUpdate(instrs);
+    }
+    futex_unlock(&updateLock);
+}
+
+void TelemetrySliceDone(uint64_t instrs, uint64_t statsDumpNs) {
+    if (!rec) return;
+    // Slice ends may fire on several threads of this process
+    __atomic_fetch_add(&rec->slices, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&rec->statsDumpNs, statsDumpNs, __ATOMIC_RELAXED);
+    TelemetryUpdate(instrs);
+}
+
+void TelemetryFini() {
+    if (!rec) return;
+    munmap(rec, sizeof(TelemetryRecord));
+    rec = nullptr;
+    unlink(recPath);
+}
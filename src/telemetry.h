@@ -0,0 +1,88 @@
+/** $lic$
+ * Copyright (C) 2012-2015 by Massachusetts Institute of Technology
+ * Copyright (C) 2010-2013 by The Board of Trustees of Stanford University
+ *
+ * This file is part of zsim.
+ *
+ * zsim is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, version 2.
+ *
+ * If you use this software in your research, we request that you reference
+ * the zsim paper ("ZSim: Fast and Accurate Microarchitectural Simulation of
+ * Thousand-Core Systems", Sanchez and Kozyrakis, ISCA-40, June 2013) as the
+ * source of the simulator in any publications that use this software, and that
+ * you send us a citation of your work.
+ *
+ * zsim is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+
+/* Live per-process telemetry, for monitoring many concurrent runs on a node.
+ *
+ * Each zsim process mmaps a small file, <sim.telemetryDir>/<pid>.tel, that
+ * holds a TelemetryRecord. The process updates it with relaxed atomic stores
+ * at the end of every slice and, from its own threads' phase barriers, every
+ * TELEMETRY_PHASE_INTERVAL phases, so a reader (scripts/zsim_top.py) can
+ * aggregate all jobs on the node without touching logs or stats files. A
+ * record whose updateNs stops advancing belongs to a slow or stuck run, or to
+ * one whose threads are all blocked or fast-forwarding; one whose pid is gone
+ * belongs to a run that died without cleaning up. The file is removed on a
+ * clean exit.
+ *
+ * Several threads of a process may update its record concurrently (e.g., slice
+ * ends fire per thread); counters are bumped with atomic adds, and the KIPS
+ * bookkeeping is serialized by a process-local lock.
+ *
+ * The layout is fixed; bump TELEMETRY_VERSION and update zsim_top.py if you
+ * change it. magic is written last on creation, so readers can skip records
+ * that are still being initialized.
+ */
+
+#define TELEMETRY_MAGIC 0x454c45544d49535aul  // "ZSIMTELE"
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_PHASE_INTERVAL 1024  // phases between updates, besides slice ends
+
+struct TelemetryRecord {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t procIdx;
+    uint64_t pid;
+    uint64_t startNs;        // all times are CLOCK_REALTIME, as getNs()
+    uint64_t updateNs;
+
+    uint64_t instrs;         // simulated instructions of this process
+    uint64_t slices;         // slices completed by this process
+    uint64_t phases;         // global phase count
+    uint64_t hostKips;       // simulated KIPS since the previous update
+
+    uint64_t boundNs;        // global simulator time breakdown (see zinfo->profSimTime)
+    uint64_t weaveNs;
+    uint64_t ffNs;
+    uint64_t statsDumpNs;    // time this process spent dumping periodic stats at slice ends
+
+    uint64_t heapUsedBytes;  // global heap footprint and reserved size (see galloc)
+    uint64_t heapBytes;
+
+    char outputDir[256];
+};  // 376 bytes
+
+// (Re)creates this process's record; an empty dir disables telemetry. Call again in forked children.
+void TelemetryInit(const char* dir, uint32_t procIdx);
+void TelemetryUpdate(uint64_t instrs);
+// Cheap per-barrier check; updates at most once every TELEMETRY_PHASE_INTERVAL phases
+void TelemetryPhaseTick(uint64_t instrs);
+void TelemetrySliceDone(uint64_t instrs, uint64_t statsDumpNs);
+void TelemetryFini();
+
+#endif  // TELEMETRY_H_
@@ -24,6 +24,8 @@
  */
 
 #include "timing_cache.h"
+#include <algorithm>
+#include <functional>
 #include "event_recorder.h"
 #include "timing_event.h"
 #include "zsim.h"
@@ -79,15 +81,18 @@ class ReplAccessEvent : public TimingEvent {
 };
 
 TimingCache::TimingCache(uint32_t _numLines, CC* _cc, CacheArray* _array, ReplPolicy* _rp,
-        uint32_t _accLat, uint32_t _invLat, uint32_t mshrs, uint32_t _tagLat, uint32_t _ways, uint32_t _cands, uint32_t _domain, const g_string& _name)
-    : Cache(_numLines, _cc, _array, _rp, _accLat, _invLat, _name), numMSHRs(mshrs), tagLat(_tagLat), ways(_ways), cands(_cands)
+        uint32_t _accLat, uint32_t _invLat, uint32_t mshrs, uint32_t _tagLat, uint32_t _ways, uint32_t _cands, uint32_t _domain, const g_string& _name, bool _elideHits)
+    : Cache(_numLines, _cc, _array, _rp, _accLat, _invLat, _name), numMSHRs(mshrs), tagLat(_tagLat), ways(_ways), cands(_cands), elideHits(_elideHits)
 {
     lastFreeCycle = 0;
     lastAccCycle = 0;
     assert(numMSHRs > 0);
     activeMisses = 0;
     domain = _domain;
-    info("%s: mshrs %d domain %d", name.c_str(), numMSHRs, domain);
+    boundMissDone.resize(numMSHRs, 0);
+    lastRecordedCycle = -1L;
+    elidedBlockedCycle = 0;
+    info("%s: mshrs %d domain %d%s", name.c_str(), numMSHRs, domain, elideHits? ", eliding uncontended hits" : "");
 }
 
 void TimingCache::initStats(AggregateStat* parentStat) {
@@ -107,6 +112,15 @@ void TimingCache::initStats(AggregateStat* parentStat) {
     cacheStat->append(&profMissRespLat);
     cacheStat->append(&profMissLat);
 
+    if (elideHits) {
+        profHitsElided.init("hitsElided", "Hits with no weave-phase events (bound-phase latency used)");
+        profHitsElidedLate.init("hitsElidedLate", "Elided hits that the weave phase would have delayed (tag port or MSHRs)");
+        profElidedLateCycles.init("elidedLateCycles", "Cumulative weave-phase delay not charged to elided hits");
+        cacheStat->append(&profHitsElided);
+        cacheStat->append(&profHitsElidedLate);
+        cacheStat->append(&profElidedLateCycles);
+    }
+
     parentStat->append(cacheStat);
 }
 
@@ -156,10 +170,33 @@ uint64_t TimingCache::access(MemReq& req) {
             // Hit
             assert(!writebackRecord.isValid());
             assert(!accessRecord.isValid());
-            uint64_t hitLat = respCycle - req.cycle; // accLat + invLat
-            HitEvent* ev = new (evRec) HitEvent(this, hitLat, domain);
-            ev->setMinStartCycle(req.cycle);
-            tr.startEvent = tr.endEvent = ev;
+
+            /* In the weave phase, a hit only deviates from its bound-phase latency if
+             * all MSHRs are busy or it collides with another lookup on the tag port.
+             * If the bound phase shows neither, skip the record: the access keeps its
+             * bound-phase latency, and neither this cache nor the core above create
+             * events for it. The hit still uses the tag port in the weave phase, so
+             * accesses recorded before or after it see the same port contention:
+             * its cycle is queued and replayed ahead of later weave-phase lookups.
+             *
+             * This is an approximation, which is why it's opt-in: weave-phase delays
+             * of earlier misses can make an elided hit find no free MSHR, or find
+             * the port busy. hitsElidedLate and elidedLateCycles count exactly the
+             * delay that elision failed to charge, so each run reports its error.
+             */
+            if (elideHits && req.cycle != lastRecordedCycle &&
+                    req.cycle >= *std::min_element(boundMissDone.begin(), boundMissDone.end())) {
+                profHitsElided.inc();
+                elidedHits.push_back(req.cycle);
+                std::push_heap(elidedHits.begin(), elidedHits.end(), std::greater<uint64_t>());
+                // Bound the queue if this cache sees few weave events; earlier phases are fully woven
+                if (elidedHits.size() >= 4096) replayElidedHits(zinfo->globPhaseCycles, true);
+            } else {
+                uint64_t hitLat = respCycle - req.cycle; // accLat + invLat
+                HitEvent* ev = new (evRec) HitEvent(this, hitLat, domain);
+                ev->setMinStartCycle(req.cycle);
+                tr.startEvent = tr.endEvent = ev;
+            }
         } else {
             assert_msg(getDoneCycle == respCycle, "gdc %ld rc %ld", getDoneCycle, respCycle);
 
@@ -255,8 +292,15 @@ uint64_t TimingCache::access(MemReq& req) {
 
             tr.startEvent = mse;
             tr.endEvent = mre; // note the end event is the response, not the wback
+
+            if (elideHits) {
+                *std::min_element(boundMissDone.begin(), boundMissDone.end()) = MAX(evDoneCycle, getDoneCycle);
+            }
+        }
+        if (tr.startEvent) {
+            lastRecordedCycle = req.cycle;
+            evRec->pushRecord(tr);
         }
-        evRec->pushRecord(tr);
     }
 
     cc->endAccess(req);
@@ -267,7 +311,44 @@ uint64_t TimingCache::access(MemReq& req) {
 }
 
 
+/* Applies the tag-port use of elided hits up to cycle, as simulateHit would
+ * have. Hits stay queued while all MSHRs are busy (they would have waited in
+ * pendingQueue), unless ignoreMSHRs. An elided hit before the current busy run
+ * of the port found a free slot then, so it does not affect later accesses.
+ */
+void TimingCache::replayElidedHits(uint64_t cycle, bool ignoreMSHRs) {
+    while (!elidedHits.empty() && elidedHits.front() <= cycle) {
+        if (!ignoreMSHRs && activeMisses >= numMSHRs) {
+            elidedBlockedCycle = cycle;
+            break;
+        }
+        std::pop_heap(elidedHits.begin(), elidedHits.end(), std::greater<uint64_t>());
+        uint64_t hitCycle = elidedHits.back();
+        elidedHits.pop_back();
+
+        // A hit that waited for an MSHR retries once one frees up, after elidedBlockedCycle
+        uint64_t startCycle = hitCycle;
+        if (!ignoreMSHRs && hitCycle <= elidedBlockedCycle) startCycle = MIN(elidedBlockedCycle + 1, cycle);
+
+        uint64_t lookupCycle;
+        if (lastAccCycle + 1 < startCycle) {
+            lastFreeCycle = startCycle - 1;
+            lookupCycle = startCycle;
+        } else if (startCycle > lastFreeCycle) {
+            lookupCycle = lastAccCycle + 1;
+        } else {
+            continue;
+        }
+        lastAccCycle = lookupCycle;
+        if (lookupCycle > hitCycle && !ignoreMSHRs) {
+            profHitsElidedLate.inc();
+            profElidedLateCycles.inc(lookupCycle - hitCycle);
+        }
+    }
+}
+
 uint64_t TimingCache::highPrioAccess(uint64_t cycle) {
+    if (elideHits) replayElidedHits(cycle, false);
     assert(cycle >= lastFreeCycle);
     uint64_t lookupCycle = MAX(cycle, lastAccCycle+1);
     if (lastAccCycle < cycle-1) lastFreeCycle = cycle-1; //record last free run
@@ -286,6 +367,7 @@ uint64_t TimingCache::highPrioAccess(uint64_t cycle) {
  * cycle in advance.
  */
 uint64_t TimingCache::tryLowPrioAccess(uint64_t cycle) {
+    if (elideHits) replayElidedHits(cycle, false);
     if (lastAccCycle < cycle-1 || lastFreeCycle == cycle-1) {
         lastFreeCycle = 0;
         lastAccCycle = MAX(cycle-1, lastAccCycle);
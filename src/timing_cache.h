@@ -28,6 +28,7 @@
 
 #include "breakdown_stats.h"
 #include "cache.h"
+#include "g_std/g_vector.h"
 
 class HitEvent;
 class MissStartEvent;
@@ -51,13 +52,23 @@ class TimingCache : public Cache {
         // For zcache replacement simulation (pessimistic, assumes we walk the whole tree)
         uint32_t tagLat, ways, cands;
 
+        // Hit elision: hits that find a free MSHR (by bound-phase timing) and don't share a cycle with
+        // an earlier recorded access produce no timing record, so the core links no weave events for them.
+        // Their tag-port use is still replayed in the weave phase (see replayElidedHits)
+        bool elideHits;
+        g_vector<uint64_t> boundMissDone;  // bound-phase done cycles of the last numMSHRs recorded misses
+        uint64_t lastRecordedCycle;
+        g_vector<uint64_t> elidedHits;  // min-heap of bound-phase cycles of elided hits not yet replayed
+        uint64_t elidedBlockedCycle;    // last weave-phase cycle that found elided hits waiting for an MSHR
+        Counter profHitsElided, profHitsElidedLate, profElidedLateCycles;
+
         PAD();
         lock_t topLock;
         PAD();
 
     public:
         TimingCache(uint32_t _numLines, CC* _cc, CacheArray* _array, ReplPolicy* _rp, uint32_t _accLat, uint32_t _invLat, uint32_t mshrs,
-                uint32_t tagLat, uint32_t ways, uint32_t cands, uint32_t _domain, const g_string& _name);
+                uint32_t tagLat, uint32_t ways, uint32_t cands, uint32_t _domain, const g_string& _name, bool _elideHits = false);
         void initStats(AggregateStat* parentStat);
 
         uint64_t access(MemReq& req);
@@ -71,6 +82,7 @@ class TimingCache : public Cache {
     private:
         uint64_t highPrioAccess(uint64_t cycle);
         uint64_t tryLowPrioAccess(uint64_t cycle);
+        void replayElidedHits(uint64_t cycle, bool ignoreMSHRs);
 };
 
 #endif  // TIMING_CACHE_H_
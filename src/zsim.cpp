@@ -42,6 +42,7 @@
 #include <sys/resource.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include "bbv_profiler.h"
 #include "constants.h"
 #include "contention_sim.h"
 #include "core.h"
@@ -50,14 +51,17 @@
 #include "debug_zsim.h"
 #include "event_queue.h"
 #include "galloc.h"
+#include "host_prof.h"
 #include "init.h"
 #include "log.h"
 #include "pin.H"
 #include "pin_cmd.h"
+#include "placement.h"
 #include "process_tree.h"
 #include "profile_stats.h"
 #include "scheduler.h"
 #include "stats.h"
+#include "telemetry.h"
 #include "virt/virt.h"
 #include "str.h"
 #include "config.h"
@@ -109,6 +113,8 @@ Address procMask;
 
 static ProcessTreeNode* procTreeNode;
 
+static BBVProfiler* bbvProfiler; //process-local copy of zinfo->bbvProfiler, avoids an extra load per BBL
+
 //tid to cid translation
 #define INVALID_CID ((uint32_t)-1)
 #define UNINITIALIZED_CID ((uint32_t)-2) //Value set at initialization
@@ -172,15 +178,20 @@ VOID FFThread(VOID* arg);
 InstrFuncPtrs fPtrs[MAX_THREADS] ATTR_LINE_ALIGNED; //minimize false sharing
 
 VOID PIN_FAST_ANALYSIS_CALL IndirectLoadSingle(THREADID tid, ADDRINT addr) {
+    HOST_PROF_SCOPE(HP_MEM_CALLBACK);
     fPtrs[tid].loadPtr(tid, addr);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL IndirectStoreSingle(THREADID tid, ADDRINT addr) {
+    HOST_PROF_SCOPE(HP_MEM_CALLBACK);
     fPtrs[tid].storePtr(tid, addr);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL IndirectBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
+    HOST_PROF_SCOPE(HP_BBL_CALLBACK);
     fPtrs[tid].bblPtr(tid, bblAddr, bblInfo);
+    // Record after bblPtr, which may end the slice; this BBL belongs to the next one
+    if (unlikely(bbvProfiler != nullptr)) bbvProfiler->record(bblInfo->bblIdx, bblInfo->instrs);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL IndirectRecordBranch(THREADID tid, ADDRINT branchPc, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {
@@ -188,13 +199,54 @@ VOID PIN_FAST_ANALYSIS_CALL IndirectRecordBranch(THREADID tid, ADDRINT branchPc,
 }
 
 VOID PIN_FAST_ANALYSIS_CALL IndirectPredLoadSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    HOST_PROF_SCOPE(HP_MEM_CALLBACK);
     fPtrs[tid].predLoadPtr(tid, addr, pred);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL IndirectPredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {
+    HOST_PROF_SCOPE(HP_MEM_CALLBACK);
     fPtrs[tid].predStorePtr(tid, addr, pred);
 }
 
+/* Buffered address capture (see MEMBUF_* in core.h). The write pointer lives in a
+ * Pin tool register, so the per-access code is trivial and inlined, and memory
+ * accesses cost no analysis calls; the BBL callback drains and resets the buffer.
+ */
+static REG memBufReg;
+static ADDRINT* memBufs[MAX_THREADS];
+
+// Must stay trivial so that Pin inlines them
+ADDRINT PIN_FAST_ANALYSIS_CALL BufferLoad(ADDRINT* ptr, ADDRINT addr) {
+    *ptr = addr & ~MEMBUF_STORE;
+    return (ADDRINT)(ptr + 1);
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL BufferStore(ADDRINT* ptr, ADDRINT addr) {
+    *ptr = addr | MEMBUF_STORE;
+    return (ADDRINT)(ptr + 1);
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL BufferPredLoad(ADDRINT* ptr, ADDRINT addr, BOOL pred) {
+    *ptr = (addr & ~MEMBUF_STORE) | (MEMBUF_PRED_FALSE & -(ADDRINT)!pred);
+    return (ADDRINT)(ptr + 1);
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL BufferPredStore(ADDRINT* ptr, ADDRINT addr, BOOL pred) {
+    *ptr = addr | (MEMBUF_PRED_FALSE & -(ADDRINT)!pred) | MEMBUF_STORE;
+    return (ADDRINT)(ptr + 1);
+}
+
+ADDRINT PIN_FAST_ANALYSIS_CALL IndirectBufferedBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo, ADDRINT* bufEnd) {
+    ADDRINT* buf = memBufs[tid];
+    if (bufEnd != buf) {
+        HOST_PROF_SCOPE(HP_MEM_CALLBACK);
+        assert(bufEnd - buf <= MEMBUF_ENTRIES);
+        fPtrs[tid].memBufPtr(tid, buf, bufEnd - buf);
+    }
+    IndirectBasicBlock(tid, bblAddr, bblInfo);
+    return (ADDRINT)buf;
+}
+
 
 //Non-simulation variants of analysis functions
 
@@ -243,11 +295,17 @@ VOID JoinAndPredStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {
     fPtrs[tid].predStorePtr(tid, addr, pred);
 }
 
+VOID JoinAndMemBuf(THREADID tid, const ADDRINT* addrs, uint32_t n) {
+    Join(tid);
+    fPtrs[tid].memBufPtr(tid, addrs, n);
+}
+
 // NOP variants: Do nothing
 VOID NOPLoadStoreSingle(THREADID tid, ADDRINT addr) {}
 VOID NOPBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {}
 VOID NOPRecordBranch(THREADID tid, ADDRINT addr, BOOL taken, ADDRINT takenNpc, ADDRINT notTakenNpc) {}
 VOID NOPPredLoadStoreSingle(THREADID tid, ADDRINT addr, BOOL pred) {}
+VOID NOPMemBuf(THREADID tid, const ADDRINT* addrs, uint32_t n) {}
 
 // FF is basically NOP except for basic blocks
 VOID FFBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
@@ -369,13 +427,13 @@ VOID FFIEntryBasicBlock(THREADID tid, ADDRINT bblAddr, BblInfo* bblInfo) {
 }
 
 // Non-analysis pointer vars
-static const InstrFuncPtrs joinPtrs = {JoinAndLoadSingle, JoinAndStoreSingle, JoinAndBasicBlock, JoinAndRecordBranch, JoinAndPredLoadSingle, JoinAndPredStoreSingle, FPTR_JOIN};
-static const InstrFuncPtrs nopPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, NOPBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
-static const InstrFuncPtrs retryPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, NOPBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_RETRY};
-static const InstrFuncPtrs ffPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
+static const InstrFuncPtrs joinPtrs = {JoinAndLoadSingle, JoinAndStoreSingle, JoinAndBasicBlock, JoinAndRecordBranch, JoinAndPredLoadSingle, JoinAndPredStoreSingle, JoinAndMemBuf, FPTR_JOIN};
+static const InstrFuncPtrs nopPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, NOPBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, NOPMemBuf, FPTR_NOP};
+static const InstrFuncPtrs retryPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, NOPBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, NOPMemBuf, FPTR_RETRY};
+static const InstrFuncPtrs ffPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, NOPMemBuf, FPTR_NOP};
 
-static const InstrFuncPtrs ffiPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
-static const InstrFuncPtrs ffiEntryPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIEntryBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, FPTR_NOP};
+static const InstrFuncPtrs ffiPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, NOPMemBuf, FPTR_NOP};
+static const InstrFuncPtrs ffiEntryPtrs = {NOPLoadStoreSingle, NOPLoadStoreSingle, FFIEntryBasicBlock, NOPRecordBranch, NOPPredLoadStoreSingle, NOPPredLoadStoreSingle, NOPMemBuf, FPTR_NOP};
 
 static const InstrFuncPtrs& GetFFPtrs() {
     return ffiEnabled? (ffiNFF? ffiEntryPtrs : ffiPtrs) : ffPtrs;
@@ -411,6 +469,51 @@ void ExitFastForward() {
     }
 }
 
+/* Native-speed skip (processX.skipInstrs)
+ *
+ * Skips the first skipInstrs instructions of the process before simulation
+ * starts. Unlike regular FF or FFI, which keep the full decode + per-instruction
+ * instrumentation and just route it to NOPs, while skipping we only insert an
+ * inlinable If/Then per BBL that counts instructions. When the count would be
+ * crossed, we exit FF, drop the code cache and restart the current BBL with
+ * the full instrumentation, so the switch happens at BBL granularity.
+ *
+ * REQUIREMENTS: Single-threaded while skipping (the counter is not atomic)
+ */
+static bool skipActive;
+static uint64_t skipInstrsDone;
+static uint64_t skipInstrsTarget;
+
+VOID SkipInit() {
+    skipInstrsTarget = procTreeNode->getSkipInstrs();
+    skipInstrsDone = 0;
+    skipActive = skipInstrsTarget && procTreeNode->isInFastForward();
+    if (skipActive) info("Skipping %ld instructions at native speed", skipInstrsTarget);
+}
+
+// Must stay trivial so that Pin inlines it
+ADDRINT PIN_FAST_ANALYSIS_CALL SkipIfCrossed(UINT32 instrs) {
+    skipInstrsDone += instrs;
+    return skipInstrsDone > skipInstrsTarget;
+}
+
+VOID SkipEnd(THREADID tid, UINT32 instrs, const CONTEXT* ctxt) {
+    skipInstrsDone -= instrs; //this BBL will run simulated
+    skipActive = false;
+    info("Skip done, %ld instrs, starting simulation", skipInstrsDone);
+
+    futex_lock(&zinfo->ffLock);
+    assert(procTreeNode->isInFastForward());
+    ExitFastForward();
+    futex_unlock(&zinfo->ffLock);
+
+    SimThreadStart(tid);
+
+    //Flush the counting-only code and re-run this BBL fully instrumented; does not return
+    PIN_RemoveInstrumentation();
+    PIN_ExecuteAt(ctxt);
+}
+
 
 
 //Termination
@@ -494,16 +597,21 @@ VOID EndOfPhaseActions() {
     }
 
     CheckForTermination();
-    zinfo->contentionSim->simulatePhase(zinfo->globPhaseCycles + zinfo->phaseLength);
+    {
+        HOST_PROF_SCOPE(HP_WEAVE);
+        zinfo->contentionSim->simulatePhase(zinfo->globPhaseCycles + zinfo->phaseLength);
+    }
     zinfo->eventQueue->tick();
     zinfo->profSimTime->transition(PROF_BOUND);
 }
 
 
 uint32_t TakeBarrier(uint32_t tid, uint32_t cid) {
+    HOST_PROF_SCOPE(HP_BARRIER);
     uint32_t newCid = zinfo->sched->sync(procIdx, tid, cid);
     clearCid(tid); //this is after the sync for a hack needed to make EndOfPhase reliable
     setCid(tid, newCid);
+    TelemetryPhaseTick(total_icount);  // per process, so every process's record stays fresh
 
     if (procTreeNode->isInFastForward()) {
         info("Thread %d entering fast-forward", tid);
@@ -534,7 +642,52 @@ static void PrintIp(THREADID tid, ADDRINT ip) {
 }
 #endif
 
-VOID Instruction(INS ins) {
+/* Whether the BBL's accesses can be buffered: every execution must fit in the
+ * buffer and in the models' per-BBL load and store arrays. REP instructions run their IPOINT_BEFORE calls once per iteration, so
+ * their accesses are unbounded. Other BBLs use the per-access callbacks; their
+ * BBL callback still drains the buffer, so entries from the previous BBL are
+ * delivered in order.
+ */
+static bool CanBufferMem(BBL bbl) {
+    uint32_t loads = 0;
+    uint32_t stores = 0;
+    for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+        uint32_t insLoads = INS_IsMemoryRead(ins) + INS_HasMemoryRead2(ins);
+        uint32_t insStores = INS_IsMemoryWrite(ins);
+        if ((insLoads || insStores) && INS_HasRealRep(ins)) return false;
+        loads += insLoads;
+        stores += insStores;
+    }
+    return loads <= MEMBUF_MAX_LOADS && stores <= MEMBUF_MAX_STORES;
+}
+
+static void InstrumentBufferedMem(INS ins) {
+    if (INS_IsMemoryRead(ins)) {
+        if (!INS_IsPredicated(ins)) {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BufferLoad, IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, memBufReg, IARG_MEMORYREAD_EA, IARG_RETURN_REGS, memBufReg, IARG_END);
+        } else {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BufferPredLoad, IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, memBufReg, IARG_MEMORYREAD_EA, IARG_EXECUTING, IARG_RETURN_REGS, memBufReg, IARG_END);
+        }
+    }
+
+    if (INS_HasMemoryRead2(ins)) {
+        if (!INS_IsPredicated(ins)) {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BufferLoad, IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, memBufReg, IARG_MEMORYREAD2_EA, IARG_RETURN_REGS, memBufReg, IARG_END);
+        } else {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BufferPredLoad, IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, memBufReg, IARG_MEMORYREAD2_EA, IARG_EXECUTING, IARG_RETURN_REGS, memBufReg, IARG_END);
+        }
+    }
+
+    if (INS_IsMemoryWrite(ins)) {
+        if (!INS_IsPredicated(ins)) {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BufferStore, IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, memBufReg, IARG_MEMORYWRITE_EA, IARG_RETURN_REGS, memBufReg, IARG_END);
+        } else {
+            INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)BufferPredStore, IARG_FAST_ANALYSIS_CALL, IARG_REG_VALUE, memBufReg, IARG_MEMORYWRITE_EA, IARG_EXECUTING, IARG_RETURN_REGS, memBufReg, IARG_END);
+        }
+    }
+}
+
+VOID Instruction(INS ins, bool bufferMem) {
     //Uncomment to print an instruction trace
     //INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)PrintIp, IARG_THREAD_ID, IARG_REG_VALUE, REG_INST_PTR, IARG_END);
 
@@ -545,7 +698,10 @@ VOID Instruction(INS ins) {
         AFUNPTR PredLoadFuncPtr = (AFUNPTR) IndirectPredLoadSingle;
         AFUNPTR PredStoreFuncPtr = (AFUNPTR) IndirectPredStoreSingle;
 
-        if (INS_IsMemoryRead(ins)) {
+        bool instrMem = (zinfo->instrReqs & INSTR_REQ_MEM) && !bufferMem;
+        bool instrBranch = zinfo->instrReqs & INSTR_REQ_BRANCH;
+
+        if (instrMem && INS_IsMemoryRead(ins)) {
             if (!INS_IsPredicated(ins)) {
                 INS_InsertCall(ins, IPOINT_BEFORE, LoadFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYREAD_EA, IARG_END);
             } else {
@@ -553,7 +709,7 @@ VOID Instruction(INS ins) {
             }
         }
 
-        if (INS_HasMemoryRead2(ins)) {
+        if (instrMem && INS_HasMemoryRead2(ins)) {
             if (!INS_IsPredicated(ins)) {
                 INS_InsertCall(ins, IPOINT_BEFORE, LoadFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYREAD2_EA, IARG_END);
             } else {
@@ -561,7 +717,7 @@ VOID Instruction(INS ins) {
             }
         }
 
-        if (INS_IsMemoryWrite(ins)) {
+        if (instrMem && INS_IsMemoryWrite(ins)) {
             if (!INS_IsPredicated(ins)) {
                 INS_InsertCall(ins, IPOINT_BEFORE,  StoreFuncPtr, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_END);
             } else {
@@ -569,11 +725,16 @@ VOID Instruction(INS ins) {
             }
         }
 
-        // Instrument only conditional branches
-        if (INS_Category(ins) == XED_CATEGORY_COND_BR && !INS_IsXend(ins)) {
+        // Instrument only conditional branches, and only those whose outcome can't be inferred from the next BBL
+        if (instrBranch && INS_Category(ins) == XED_CATEGORY_COND_BR && !INS_IsXend(ins) &&
+                !(zinfo->inferBranches && Decoder::isInferableBranch(ins))) {
             INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR) IndirectRecordBranch, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID,
                     IARG_INST_PTR, IARG_BRANCH_TAKEN, IARG_BRANCH_TARGET_ADDR, IARG_FALLTHROUGH_ADDR, IARG_END);
         }
+
+        if ((zinfo->instrReqs & INSTR_REQ_MEM) && bufferMem) {
+            InstrumentBufferedMem(ins);
+        }
     }
 }
 
@@ -705,21 +866,39 @@ VOID Trace(TRACE trace, VOID *v) {
         return;
     }
 
+    if (unlikely(skipActive)) {
+        // Only count instructions; MiscHandle must still run for correctness (syscalls, rdtsc, vDSO)
+        for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+            BBL_InsertIfCall(bbl, IPOINT_BEFORE, (AFUNPTR)SkipIfCrossed, IARG_FAST_ANALYSIS_CALL, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+            BBL_InsertThenCall(bbl, IPOINT_BEFORE, (AFUNPTR)SkipEnd, IARG_THREAD_ID, IARG_UINT32, BBL_NumIns(bbl), IARG_CONTEXT, IARG_END);
+            for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
+                MiscHandle(ins);
+            }
+        }
+        return;
+    }
+
     if (!procTreeNode->isInFastForward() || !zinfo->ffReinstrument) {
         // Visit every basic block in the trace
         for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
             BblInfo* bblInfo = Decoder::decodeBbl(bbl, zinfo->oooDecode);
-            BBL_InsertCall(bbl, IPOINT_BEFORE /*could do IPOINT_ANYWHERE if we redid load and store simulation in OOO*/, (AFUNPTR)IndirectBasicBlock, IARG_FAST_ANALYSIS_CALL,
-                 IARG_THREAD_ID, IARG_ADDRINT, BBL_Address(bbl), IARG_PTR, bblInfo, IARG_END);
+            if ((zinfo->instrReqs & INSTR_REQ_MEM) && zinfo->bufferMemAddrs) {
+                BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)IndirectBufferedBasicBlock, IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID, IARG_ADDRINT, BBL_Address(bbl), IARG_PTR, bblInfo, IARG_REG_VALUE, memBufReg, IARG_RETURN_REGS, memBufReg, IARG_END);
+            } else {
+                BBL_InsertCall(bbl, IPOINT_BEFORE /*could do IPOINT_ANYWHERE if we redid load and store simulation in OOO*/, (AFUNPTR)IndirectBasicBlock, IARG_FAST_ANALYSIS_CALL,
+                     IARG_THREAD_ID, IARG_ADDRINT, BBL_Address(bbl), IARG_PTR, bblInfo, IARG_END);
+            }
         }
     }
 
     //Instruction instrumentation now here to ensure proper ordering
     for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl)) {
+        bool bufferMem = zinfo->bufferMemAddrs && CanBufferMem(bbl);
         for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins)) {
             do_inst_count(ins);
             if(zinfo->oooDecode){
-                Instruction(ins);
+                Instruction(ins, bufferMem);
             }
             MiscHandle(ins);
         }
@@ -932,20 +1111,8 @@ void SimThreadStart(THREADID tid) {
     zinfo->sched->start(procIdx, tid, procTreeNode->getMask());
     activeThreads[tid] = true;
 
-    //Pinning
-#if 0
-    if (true) {
-        uint32_t nprocs = sysconf(_SC_NPROCESSORS_ONLN);
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        CPU_SET(tid % nprocs, &cpuset);
-        //HMM, can we do this? I doubt it
-        //int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
-        //Since we're running multiprocess, this suffices for now:
-        int result = sched_setaffinity(getpid(), sizeof(cpu_set_t), &cpuset);
-        assert(result == 0);
-    }
-#endif
+    //Pinning. Tool code runs on the app thread, so this pins just this thread
+    if (zinfo->placement) zinfo->placement->placeAppThread(tid);
 
     //Initialize this thread's process-local data
     fPtrs[tid] = joinPtrs; //delayed, MT-safe barrier join
@@ -953,6 +1120,11 @@ void SimThreadStart(THREADID tid) {
 }
 
 VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
+    if (zinfo->bufferMemAddrs) {
+        if (!memBufs[tid]) memBufs[tid] = new ADDRINT[MEMBUF_ENTRIES];
+        PIN_SetContextReg(ctxt, memBufReg, (ADDRINT)memBufs[tid]);
+    }
+
     /* This should only fire for the first thread; I know this is a callback,
      * everything is serialized etc; that's the point, we block everything.
      * It's here and not in main() because that way the auxiliary threads can
@@ -982,6 +1154,7 @@ VOID SimThreadFini(THREADID tid) {
     cerr << "Total icount: " << total_icount << endl;
     if(emit_last_slice && interval_icount != (uint64_t)interval_size){
         zinfo -> periodicStatsBackend -> dump(false);// flushes trace writer
+        if (zinfo->bbvProfiler) zinfo->bbvProfiler->dump();
     }
     // zinfo->sched->leave(); //exit syscall (SyscallEnter) already leaves
     zinfo->sched->finish(procIdx, tid);
@@ -1149,6 +1322,11 @@ BOOL FollowChild(CHILD_PROCESS childProcess, VOID * userData) {
 
 static ProcessTreeNode* forkedChildNode = nullptr;
 
+// Gives the global heap lock-free per-thread caches, see galloc.cpp
+static uint32_t GetGMThreadId() {
+    return PIN_ThreadId();  // INVALID_THREADID (>= MAX_THREADS) for non-Pin threads
+}
+
 VOID BeforeFork(THREADID tid, const CONTEXT* ctxt, VOID * arg) {
     forkedChildNode = procTreeNode->getNextChild();
     info("Thread %d forking, child procIdx=%d", tid, forkedChildNode->getProcIdx());
@@ -1159,6 +1337,7 @@ VOID AfterForkInParent(THREADID tid, const CONTEXT* ctxt, VOID * arg) {
 }
 
 VOID AfterForkInChild(THREADID tid, const CONTEXT* ctxt, VOID * arg) {
+    gm_drop_thread_caches();  // the parent keeps using the blocks they hold
     assert(forkedChildNode);
     procTreeNode = forkedChildNode;
     procIdx = procTreeNode->getProcIdx();
@@ -1173,6 +1352,7 @@ VOID AfterForkInChild(THREADID tid, const CONTEXT* ctxt, VOID * arg) {
     InitLog(header, KnobLogToFile.Value()? logfile_ss.str().c_str() : nullptr);
 
     info("Forked child (tid %d/%d), PID %d, parent PID %d", tid, PIN_ThreadId(), PIN_GetPid(), getppid());
+    TelemetryInit(zinfo->telemetryDir, procIdx);
 
     //Initialize process-local per-thread state, even if ThreadStart does so later
     for (uint32_t i = 0; i < MAX_THREADS; i++) {
@@ -1208,6 +1388,7 @@ VOID SimEnd() {
     }
 
     //at this point, we're in charge of exiting our whole process, but we still need to race for the stats
+    TelemetryFini();
 
     //global
     bool lastToFinish = procTreeNode->notifyEnd();
@@ -1589,6 +1770,7 @@ int main(int argc, char *argv[]) {
     //info("setpriority, new prio %d", getpriority(PRIO_PROCESS, getpid()));
 
     gm_attach(KnobShmid.Value());
+    gm_set_thread_id_fn(GetGMThreadId);
 
     bool masterProcess = false;
     if (procIdx == 0 && !gm_isready()) {  // process 0 can exec() without fork()ing first, so we must check gm_isready() to ensure we don't initialize twice
@@ -1638,9 +1820,18 @@ int main(int argc, char *argv[]) {
 
     perProcessEndFlag = 0;
 
+    bbvProfiler = zinfo->bbvProfiler;
+    hostProf = zinfo->hostProf;
+    if (hostProf) hostProf->initProcess();
+
     lineBits = ilog2(zinfo->lineSize);
     procMask = ((uint64_t)procIdx) << (64-lineBits);
 
+    if (zinfo->bufferMemAddrs) {
+        memBufReg = PIN_ClaimToolRegister();
+        if (!REG_valid(memBufReg)) panic("Could not claim a Pin tool register for sim.bufferMemAddrs, disable it");
+    }
+
     //Initialize process-local per-thread state, even if ThreadStart does so later
     for (uint32_t i = 0; i < MAX_THREADS; i++) {
         fPtrs[i] = joinPtrs;
@@ -1663,6 +1854,8 @@ int main(int argc, char *argv[]) {
 
     VirtCaptureClocks(false);
     FFIInit();
+    SkipInit();
+    TelemetryInit(zinfo->telemetryDir, procIdx);
 
     VirtInit();
 
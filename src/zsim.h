@@ -48,6 +48,7 @@ class PortVirtualizer;
 class VectorCounter;
 class AccessTraceWriter;
 class TraceDriver;
+class BBVProfiler;
 template <typename T> class g_vector;
 
 struct ClockDomainInfo {
@@ -59,6 +60,8 @@ struct ClockDomainInfo {
 };
 
 class TimeBreakdownStat;
+class HostProfiler;
+class HostPlacement;
 enum ProfileStates {
     PROF_INIT = 0,
     PROF_BOUND = 1,
@@ -108,6 +111,9 @@ struct GlobSimInfo {
     bool blockingSyscalls;
     bool perProcessCpuEnum; //if true, cpus are enumerated according to per-process masks (e.g., a 16-core mask in a 64-core sim sees 16 cores)
     bool oooDecode; //if true, Decoder does OOO (instr->uop) decoding
+    uint32_t instrReqs; //INSTR_REQ_* needed by any core; other per-instruction callbacks are not inserted
+    bool inferBranches; //if true, branches that Decoder::isInferableBranch accepts get no callback; cores infer them from the next BBL
+    bool bufferMemAddrs; //if true, memory accesses are captured by inlined code into per-thread buffers, drained at BBL callbacks (see MEMBUF_*)
 
     PAD();
 
@@ -139,6 +145,10 @@ struct GlobSimInfo {
     StatsBackend* eventualStatsBackend;
     ProcessStats* processStats;
     ProcStats* procStats;
+    BBVProfiler* bbvProfiler; //nullptr unless sim.bbv.enable
+    HostProfiler* hostProf; //nullptr unless sim.hostProf.enable
+    HostPlacement* placement; //nullptr if sim.placement.policy is None
+    const char* telemetryDir; //empty if telemetry is disabled, see telemetry.h
 
     TimeBreakdownStat* profSimTime;
     VectorCounter* profHeartbeats; //global b/c number of processes cannot be inferred at init time; we just size to max
@@ -25,16 +25,25 @@
 
 /* ZSim master process. Handles global heap creation, configuration, launching
  * slave pin processes, coordinating and terminating runs, and stats printing.
+ * With --server, it instead stays up as a job server that runs one such
+ * master per submitted job (see RunServer).
  */
 
+#include <algorithm>
+#include <deque>
+#include <errno.h>
 #include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <limits.h>
+#include <poll.h>
 #include <signal.h>
 #include <sstream>
 #include <stdlib.h>
 #include <string>
 #include <sys/personality.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <vector>
@@ -44,6 +53,7 @@
 #include "galloc.h"
 #include "log.h"
 #include "pin_cmd.h"
+#include "placement.h"
 #include "version.h" //autogenerated, in build dir, see SConstruct
 #include "zsim.h"
 
@@ -313,24 +323,16 @@ void LaunchProcess(uint32_t procIdx) {
 }
 
 
-int main(int argc, char *argv[]) {
-    if (argc == 2 && std::string(argv[1]) == "-v") {
-        printf("%s\n", ZSIM_BUILDVERSION);
-        exit(0);
-    }
+/* A global segment reserved ahead of time by the job server */
+struct PooledSegment {
+    int shmid;
+    uint32_t mbytes;
+    GMHugePages hugePages;
+};
 
-    InitLog("[H] ", nullptr /*log to stdout/err*/);
-    info("Starting zsim, built %s (rev %s)", ZSIM_BUILDDATE, ZSIM_BUILDVERSION);
+static void RunSimulation(const char* configFile, const PooledSegment* pooled) {
     startTime = time(nullptr);
 
-    if (argc != 2) {
-        info("Usage: %s config_file", argv[0]);
-        exit(1);
-    }
-
-    //Canonicalize paths --- because we change dirs, we deal in absolute paths
-    const char* configFile = realpath(argv[1], nullptr);
-
     Config conf(configFile);
 
     if (atexit(exitHandler)) panic("Could not register exit handler");
@@ -362,9 +364,26 @@ int main(int argc, char *argv[]) {
     }
     if (removedLogfiles) info("Removed %d old logfiles", removedLogfiles);
 
-    uint32_t gmSize = conf.get<uint32_t>("sim.gmMBytes", (1<<10) /*default 1024MB*/);
-    info("Creating global segment, %d MBs", gmSize);
-    int shmid = gm_init(((size_t)gmSize) << 20 /*MB to Bytes*/);
+    //With sim.placement.policy = "Socket", confine the whole job to one socket before touching the heap or launching Pin
+    ConfineJobToSocket(conf);
+
+    //Only a reservation; the segment is demand-paged, so a large default costs no physical memory
+    uint32_t gmSize = conf.get<uint32_t>("sim.gmMBytes", GM_DEFAULT_MBYTES);
+    std::string gmHugePagesStr = conf.get<const char*>("sim.gmHugePages", "None");
+    GMHugePages gmHugePages = GM_HP_NONE;
+    if (gmHugePagesStr == "None") gmHugePages = GM_HP_NONE;
+    else if (gmHugePagesStr == "THP") gmHugePages = GM_HP_THP;
+    else if (gmHugePagesStr == "HugeTLB") gmHugePages = GM_HP_HUGETLB;
+    else panic("Invalid sim.gmHugePages %s (None, THP or HugeTLB)", gmHugePagesStr.c_str());
+    int shmid;
+    if (pooled && pooled->mbytes == gmSize && pooled->hugePages == gmHugePages) {
+        info("Using pooled global segment, %d MBs, huge pages: %s", gmSize, gmHugePagesStr.c_str());
+        shmid = gm_init_reserved(pooled->shmid, ((size_t)gmSize) << 20 /*MB to Bytes*/, gmHugePages);
+    } else {
+        if (pooled) gm_release(pooled->shmid);
+        info("Creating global segment, %d MBs, huge pages: %s", gmSize, gmHugePagesStr.c_str());
+        shmid = gm_init(((size_t)gmSize) << 20 /*MB to Bytes*/, gmHugePages);
+    }
     info("Global segment shmid = %d", shmid);
     //fprintf(stderr, "%sGlobal segment shmid = %d\n", logHeader, shmid); //hack to print shmid on both streams
     //fflush(stderr);
@@ -484,3 +503,263 @@ int main(int argc, char *argv[]) {
     exit(exitCode);
 }
 
+
+/* Job server
+ *
+ * zsim_harness --server <socket> [maxJobs] [poolSegments] listens on a Unix socket.
+ * Each connection submits one job as a single line, "<config_file> [<run_dir>]"
+ * (run_dir defaults to the config file's directory), and receives its status as
+ * lines of text:
+ *   QUEUED <jobId>
+ *   STARTED <jobId> <pid>
+ *   DONE <jobId> <exitCode> <run_dir>     or     ERROR <reason>
+ * Every job runs in a forked harness (its own process group, so a hard death only
+ * takes down that job's tree) that behaves exactly like a standalone run started in
+ * run_dir; its log goes to run_dir/zsim_harness.log. Up to maxJobs (default 1) run at
+ * once. The server keeps poolSegments (default 2) default-sized global segments
+ * reserved, so jobs that use the default sim.gmMBytes/gmHugePages skip segment creation.
+ */
+
+struct ServerJob {
+    uint32_t id;
+    int fd;  // client connection
+    std::string configFile;
+    std::string runDir;
+    int pid;  // 0 while queued
+};
+
+static volatile bool serverStop = false;
+
+static void serverSigHandler(int sig) {
+    serverStop = true;
+}
+
+static void sendLine(int fd, const std::string& line) {
+    std::string msg = line + "\n";
+    // The client may have hung up; that must not take the server down (MSG_NOSIGNAL), and the job keeps running
+    if (send(fd, msg.c_str(), msg.size(), MSG_NOSIGNAL) < 0) {
+        trace(Harness, "Could not send status to client fd %d", fd);
+    }
+}
+
+static bool readJob(int fd, ServerJob& job) {
+    // Bounded wait, a stuck client should not stall the server
+    struct timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string line;
+    char c;
+    while (line.size() < 2*PATH_MAX && recv(fd, &c, 1, 0) == 1 && c != '\n') line.push_back(c);
+
+    std::istringstream iss(line);
+    std::string cfg, dir;
+    iss >> cfg >> dir;
+    if (cfg.empty()) {
+        sendLine(fd, "ERROR no config file given");
+        return false;
+    }
+
+    char* cfgPath = realpath(cfg.c_str(), nullptr);
+    if (!cfgPath) {
+        sendLine(fd, "ERROR config file " + cfg + " not found");
+        return false;
+    }
+    job.configFile = cfgPath;
+    free(cfgPath);
+
+    if (dir.empty()) dir = job.configFile.substr(0, job.configFile.rfind('/') + 1);
+    char* dirPath = realpath(dir.c_str(), nullptr);
+    if (!dirPath) {
+        sendLine(fd, "ERROR run directory " + dir + " not found");
+        return false;
+    }
+    job.runDir = dirPath;
+    free(dirPath);
+    return true;
+}
+
+static int LaunchJob(const ServerJob& job, const PooledSegment* pooled, int listenFd, const std::vector<ServerJob>& jobs) {
+    int cpid = fork();
+    if (cpid) return cpid;  // parent (or -1 if fork failed); the pooled segment now belongs to the child
+
+    // Drop the server's sockets, only our own client should see our status
+    close(listenFd);
+    for (const ServerJob& j : jobs) close(j.fd);
+
+    setpgid(0, 0);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    if (chdir(job.runDir.c_str()) != 0) {
+        if (pooled) gm_release(pooled->shmid);
+        panic("Could not chdir to %s", job.runDir.c_str());
+    }
+    int logFd = open("zsim_harness.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (logFd >= 0) {
+        dup2(logFd, 1);
+        dup2(logFd, 2);
+        close(logFd);
+    }
+
+    RunSimulation(job.configFile.c_str(), pooled);
+    return 0;  // unreachable, RunSimulation exits
+}
+
+static int RunServer(int argc, char* argv[]) {
+    const char* socketPath = argv[2];
+    uint32_t maxJobs = (argc > 3)? strtoul(argv[3], nullptr, 0) : 1;
+    uint32_t poolSegments = (argc > 4)? strtoul(argv[4], nullptr, 0) : 2;
+    if (maxJobs == 0) panic("maxJobs must be > 0");
+    const uint32_t poolMBytes = GM_DEFAULT_MBYTES;  // pooled segments only fit jobs with the default size
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(addr.sun_path)) panic("Socket path %s is too long", socketPath);
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) panic("Could not create socket");
+    unlink(socketPath);  // stale socket from a server that died
+    if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) != 0) panic("Could not bind to %s", socketPath);
+    if (listen(listenFd, 64) != 0) panic("Could not listen on %s", socketPath);
+
+    signal(SIGINT, serverSigHandler);
+    signal(SIGTERM, serverSigHandler);
+
+    info("Job server listening on %s, %d concurrent jobs, %d pooled segments", socketPath, maxJobs, poolSegments);
+
+    std::vector<ServerJob> jobs;  // in submission order; running jobs have pid != 0
+    std::deque<int> pool;
+    uint32_t nextJobId = 0;
+    uint32_t running = 0;
+    bool stopping = false;
+    bool poolWarned = false;
+
+    while (!stopping || running) {
+        if (serverStop && !stopping) {
+            info("Stopping job server, terminating %d running jobs", running);
+            stopping = true;
+            for (ServerJob& j : jobs) {
+                if (j.pid > 0) kill(j.pid, SIGINT);  // graceful, the job's harness kills its own tree
+            }
+            close(listenFd);
+            unlink(socketPath);
+        }
+
+        // Start queued jobs (FCFS) while there are free slots
+        for (ServerJob& j : jobs) {
+            if (stopping || running >= maxJobs) break;
+            if (j.pid) continue;
+            PooledSegment seg = {-1, poolMBytes, GM_HP_NONE};
+            if (!pool.empty()) {
+                seg.shmid = pool.front();
+                pool.pop_front();
+            }
+            int pid = LaunchJob(j, (seg.shmid >= 0)? &seg : nullptr, listenFd, jobs);
+            if (pid < 0) {
+                // Fail the job rather than retry, fork keeps failing under memory or process limits
+                warn("Could not fork job %d: %s", j.id, strerror(errno));
+                if (seg.shmid >= 0) pool.push_front(seg.shmid);
+                sendLine(j.fd, std::string("ERROR could not start job: ") + strerror(errno));
+                close(j.fd);
+                j.fd = -1;  // removed below
+                continue;
+            }
+            j.pid = pid;
+            running++;
+            info("Job %d started, pid %d, config %s, dir %s", j.id, j.pid, j.configFile.c_str(), j.runDir.c_str());
+            std::stringstream ss;
+            ss << "STARTED " << j.id << " " << j.pid;
+            sendLine(j.fd, ss.str());
+        }
+
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [](const ServerJob& j) { return j.fd < 0; }), jobs.end());
+
+        // Refill the pool off the jobs' critical path. If shmget fails (e.g., shmmni or shmall
+        // exhausted), do not take down the server; jobs create their own segments meanwhile
+        while (!stopping && pool.size() < poolSegments) {
+            int shmid = gm_try_reserve(((size_t)poolMBytes) << 20, GM_HP_NONE);
+            if (shmid < 0) {
+                if (!poolWarned) warn("Could not reserve a pooled segment: %s; will retry", strerror(errno));
+                poolWarned = true;
+                break;
+            }
+            poolWarned = false;
+            pool.push_back(shmid);
+        }
+
+        // Accept new jobs
+        struct pollfd pfd = {listenFd, POLLIN, 0};
+        if (!stopping && poll(&pfd, 1, 200 /*ms*/) > 0 && (pfd.revents & POLLIN)) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) {
+                ServerJob job;
+                job.fd = fd;
+                job.pid = 0;
+                if (readJob(fd, job)) {
+                    job.id = nextJobId++;
+                    jobs.push_back(job);
+                    std::stringstream ss;
+                    ss << "QUEUED " << job.id;
+                    sendLine(fd, ss.str());
+                } else {
+                    close(fd);
+                }
+            }
+        } else if (stopping) {
+            usleep(200*1000);
+        }
+
+        // Reap finished jobs
+        int status;
+        int cpid;
+        while ((cpid = waitpid(-1, &status, WNOHANG)) > 0) {
+            for (auto it = jobs.begin(); it != jobs.end(); it++) {
+                if (it->pid != cpid) continue;
+                int exitCode = WIFEXITED(status)? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+                info("Job %d done, exit code %d", it->id, exitCode);
+                std::stringstream ss;
+                ss << "DONE " << it->id << " " << exitCode << " " << it->runDir;
+                sendLine(it->fd, ss.str());
+                close(it->fd);
+                jobs.erase(it);
+                running--;
+                break;
+            }
+        }
+    }
+
+    for (ServerJob& j : jobs) {  // never started
+        sendLine(j.fd, "ERROR job server stopped");
+        close(j.fd);
+    }
+    for (int shmid : pool) gm_release(shmid);
+    info("Job server done");
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc == 2 && std::string(argv[1]) == "-v") {
+        printf("%s\n", ZSIM_BUILDVERSION);
+        exit(0);
+    }
+
+    InitLog("[H] ", nullptr /*log to stdout/err*/);
+    info("Starting zsim, built %s (rev %s)", ZSIM_BUILDDATE, ZSIM_BUILDVERSION);
+
+    if (argc >= 3 && std::string(argv[1]) == "--server") {
+        return RunServer(argc, argv);
+    }
+
+    if (argc != 2) {
+        info("Usage: %s config_file", argv[0]);
+        info("       %s --server socket_path [max_jobs] [pool_segments]", argv[0]);
+        exit(1);
+    }
+
+    //Canonicalize paths --- because we change dirs, we deal in absolute paths
+    const char* configFile = realpath(argv[1], nullptr);
+    RunSimulation(configFile, nullptr);
+    return 0;  // unreachable, RunSimulation exits
+}